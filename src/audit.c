@@ -0,0 +1,130 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "cpu_internal.h"
+
+
+/* audit.c
+
+written by: Oliver Cordes 2019-07-01
+changed by: Oliver Cordes 2019-07-01
+
+*/
+
+
+/* the audit reads the feature bits, the signature and the brand string
+   on every logical CPU of the affinity mask, the microcode revision is
+   not part of cpuid and is taken from sysfs. Hybrid CPUs also report
+   their core type, the features of P- and E-cores may differ.
+*/
+
+
+void audit_probe(int index, int cpu, void *arg)
+{
+  _cpu_audit *a = &((_cpu_audit *)arg)[index];
+
+  a->cpu = cpu;
+  a->signature = get_cpu_signature();
+  decode_cpu_features(&a->features);
+  get_cpu_brand(a->brand);
+  a->core_type = get_core_type(&a->native_model);
+  a->valid = 1;
+}
+
+
+unsigned long read_microcode(int cpu)
+{
+  char           path[128];
+  FILE          *f;
+  unsigned long  version = 0;
+
+  snprintf(path, sizeof(path),
+           "/sys/devices/system/cpu/cpu%d/microcode/version", cpu);
+
+  f = fopen(path, "r");
+  if (f == NULL)
+    return 0;
+
+  if (fscanf(f, "%lx", &version) != 1)
+    version = 0;
+  fclose(f);
+
+  return version;
+}
+
+
+/* dcpu_audit
+
+fills the audit data of all CPUs of the affinity mask into cpus,
+returns the number of CPUs or -1 on errors and for a replayed dump
+*/
+
+int dcpu_audit(_cpu_audit *cpus, int max)
+{
+  int *list;
+  int  n, i;
+
+  dcpu_init();
+
+  if (cpuid_replaying())
+    return -1;
+
+  list = (int *)malloc(max * sizeof(int));
+  if (list == NULL)
+    return -1;
+
+  n = get_cpu_list(list, max);
+  if (n > 0)
+  {
+    for (i = 0; i < n; ++i)
+    {
+      cpus[i].cpu = list[i];
+      cpus[i].valid = 0;
+    }
+    if (run_on_cpus(list, n, audit_probe, cpus) < 0)
+      n = -1;
+    for (i = 0; i < n; ++i)
+      cpus[i].microcode = read_microcode(cpus[i].cpu);
+  }
+
+  free(list);
+
+  return n;
+}
+
+
+/* dcpu_audit_common
+
+collects the features usable on all audited CPUs of a core type
+(core_type_any for all CPUs): the intersection of the features of
+the CPUs without the features the OS doesn't enable
+*/
+
+void dcpu_audit_common(const _cpu_audit *cpus, int n, int core_type,
+                       _cpu_featureset *set)
+{
+  int first = 1, i, w, f;
+
+  dcpu_init();
+
+  featureset_clear(set);
+  for (i = 0; i < n; ++i)
+  {
+    if (!cpus[i].valid
+        || ((core_type != core_type_any) && (cpus[i].core_type != core_type)))
+      continue;
+    if (first)
+      *set = cpus[i].features;
+    else
+      for (w = 0; w < HW_WORDS; ++w)
+        set->bits[w] &= cpus[i].features.bits[w];
+    first = 0;
+  }
+
+  /* XCR0, and the features the kernel disables with --effective */
+  apply_xstate_gates(set, dcpu_cpu.xcr0);
+  for (f = 0; f < HW_NUM_FEATURES; ++f)
+    if (featureset_has(&dcpu_cpu.hw_features, f)
+        && !featureset_has(&dcpu_cpu.features, f))
+      featureset_unset(set, f);
+}
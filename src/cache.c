@@ -0,0 +1,196 @@
+#include "cpu_internal.h"
+
+
+/* cache.c
+
+written by: Oliver Cordes 2019-07-01
+changed by: Oliver Cordes 2019-07-01
+
+*/
+
+
+/* the cache hierarchy is read from
+
+   EAX=4                 deterministic cache parameters (Intel)
+   EAX=8000001Dh         cache topology information (AMD, TOPOEXT)
+   EAX=80000005h/6h      L1 and L2/L3 cache information (AMD legacy)
+
+   leaf 4 and 8000001Dh share the same register layout
+*/
+
+
+/* decode_cache_params
+
+decodes one subleaf of leaf 4 / 8000001Dh, returns 0 if there are no
+more caches
+*/
+
+int decode_cache_params(int info[4], _cpu_cache *cache)
+{
+  unsigned int eax = (unsigned int)info[0];
+  unsigned int ebx = (unsigned int)info[1];
+  unsigned int ecx = (unsigned int)info[2];
+  unsigned int edx = (unsigned int)info[3];
+
+  cache->type = eax & 0x1f;
+  if (cache->type == cache_null)
+    return 0;
+
+  cache->level      = (eax >> 5) & 0x7;
+  /* the addressable IDs, a part with disabled cores has less CPUs */
+  cache->shared     = ((eax >> 14) & 0xfff) + 1;
+  cache->line_size  = (ebx & 0xfff) + 1;
+  cache->partitions = ((ebx >> 12) & 0x3ff) + 1;
+  cache->ways       = ((eax >> 9) & 1) ? 0 : (int)((ebx >> 22) & 0x3ff) + 1;
+  cache->sets       = ecx + 1;
+  cache->inclusive  = (edx >> 1) & 1;
+  cache->size       = (unsigned long)(((ebx >> 22) & 0x3ff) + 1)
+                      * cache->partitions * cache->line_size * cache->sets;
+
+  return 1;
+}
+
+
+void get_caches_deterministic(unsigned int leaf)
+{
+  int info[4];
+  int i;
+
+  for (i = 0; i < DCPU_MAX_CACHES; ++i)
+  {
+    cpuidcx(info, leaf, i);
+    if (!decode_cache_params(info, &dcpu_cpu.caches[dcpu_cpu.ncaches]))
+      break;
+    ++dcpu_cpu.ncaches;
+  }
+}
+
+
+/* amd_assoc
+
+translates the associativity encoding of EAX=80000006h, 0xf is fully
+associative, 9 refers to leaf 8000001Dh (only valid with TOPOEXT) and
+7 is reserved, both are unknown (-1)
+*/
+
+int amd_assoc(unsigned int code)
+{
+  static const int ways[16] = { 0, 1, 2, 3, 4, 6, 8, -1,
+                                16, -1, 32, 48, 64, 96, 128, 0 };
+
+  return ways[code & 0xf];
+}
+
+
+void add_legacy_cache(int level, int type, unsigned long size, int ways,
+                      int line_size)
+{
+  _cpu_cache *cache;
+
+  if ((size == 0) || (line_size == 0) || (dcpu_cpu.ncaches >= DCPU_MAX_CACHES))
+    return;
+
+  cache = &dcpu_cpu.caches[dcpu_cpu.ncaches++];
+  cache->level      = level;
+  cache->type       = type;
+  cache->size       = size;
+  cache->ways       = ways;
+  cache->line_size  = line_size;
+  cache->partitions = 1;
+  if (ways < 0)
+    cache->sets     = 0;
+  else
+    cache->sets     = (ways == 0) ? 1 : (int)(size / ((unsigned long)ways * line_size));
+  cache->inclusive  = 0;
+  cache->shared     = 0;
+}
+
+
+void get_caches_legacy(void)
+{
+  int          info[4];
+  unsigned int ecx, edx;
+
+  if (cpuid_leaf_valid(0x80000005))
+  {
+    cpuid(info, 0x80000005);
+    ecx = (unsigned int)info[2];
+    edx = (unsigned int)info[3];
+    /* L1 associativity: 0xff = fully associative */
+    add_legacy_cache(1, cache_data, (ecx >> 24) * 1024UL,
+                     ((ecx >> 16) & 0xff) == 0xff ? 0 : (int)((ecx >> 16) & 0xff),
+                     ecx & 0xff);
+    add_legacy_cache(1, cache_instruction, (edx >> 24) * 1024UL,
+                     ((edx >> 16) & 0xff) == 0xff ? 0 : (int)((edx >> 16) & 0xff),
+                     edx & 0xff);
+  }
+
+  if (cpuid_leaf_valid(0x80000006))
+  {
+    cpuid(info, 0x80000006);
+    ecx = (unsigned int)info[2];
+    edx = (unsigned int)info[3];
+    if ((ecx >> 12) & 0xf)
+      add_legacy_cache(2, cache_unified, (ecx >> 16) * 1024UL,
+                       amd_assoc(ecx >> 12), ecx & 0xff);
+    if ((edx >> 12) & 0xf)
+      add_legacy_cache(3, cache_unified, (edx >> 18) * 512UL * 1024UL,
+                       amd_assoc(edx >> 12), edx & 0xff);
+  }
+}
+
+
+void get_cpu_caches(void)
+{
+  dcpu_cpu.ncaches = 0;
+
+  switch(dcpu_cpu.cpu_type)
+  {
+    case CPU_AMD:
+    case CPU_Hygon:
+      if (featureset_has(&dcpu_cpu.features, HW_TOPOEXT)
+          && cpuid_leaf_valid(0x8000001d))
+        get_caches_deterministic(0x8000001d);
+      break;
+    default:
+      if (cpuid_leaf_valid(0x00000004))
+        get_caches_deterministic(0x00000004);
+      break;
+  }
+
+  if (dcpu_cpu.ncaches == 0)
+    get_caches_legacy();
+}
+
+
+const _cpu_cache *dcpu_caches(int *n)
+{
+  dcpu_init();
+
+  if (n != NULL)
+    *n = dcpu_cpu.ncaches;
+
+  return dcpu_cpu.caches;
+}
+
+
+/* dcpu_cache
+
+returns the cache of a level, for cache_data and cache_instruction
+a unified cache also matches, NULL if there is no such cache
+*/
+
+const _cpu_cache *dcpu_cache(int level, int type)
+{
+  int i;
+
+  dcpu_init();
+
+  for (i = 0; i < dcpu_cpu.ncaches; ++i)
+    if ((dcpu_cpu.caches[i].level == level)
+        && ((dcpu_cpu.caches[i].type == type)
+            || (dcpu_cpu.caches[i].type == cache_unified)))
+      return &dcpu_cpu.caches[i];
+
+  return NULL;
+}
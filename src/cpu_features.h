@@ -0,0 +1,238 @@
+/* cpu_features.h
+
+written by: Oliver Cordes 2019-07-01
+changed by: Oliver Cordes 2019-07-01
+
+*/
+
+/* the single feature specification table
+
+   every entry describes one CPU feature flag as
+
+     CPU_FEATURE(id, leaf, subleaf, register, bit, name, gcc, gccver)
+
+   gcc is the name of the gcc -m<gcc>/-mno-<gcc> option of the
+   feature or NULL if there is none, gccver the first gcc major release
+   knowing the option (4 for all 4.x releases), 0 without an option.
+
+   the including file has to define the CPU_FEATURE macro before
+   including this file. The table drives the decoding of the cpuid
+   leaves, the flag names and the order of the flags output.
+
+   no include guard on purpose!
+*/
+
+/* EAX=1: Processor Info and Feature Bits (EDX) */
+CPU_FEATURE(HW_FPU,             0x00000001, 0, REG_EDX,  0, "fpu", NULL, 0)
+CPU_FEATURE(HW_VME,             0x00000001, 0, REG_EDX,  1, "vme", NULL, 0)
+CPU_FEATURE(HW_DE,              0x00000001, 0, REG_EDX,  2, "de", NULL, 0)
+CPU_FEATURE(HW_PSE,             0x00000001, 0, REG_EDX,  3, "pse", NULL, 0)
+CPU_FEATURE(HW_TSC,             0x00000001, 0, REG_EDX,  4, "tsc", NULL, 0)
+CPU_FEATURE(HW_MSR,             0x00000001, 0, REG_EDX,  5, "msr", NULL, 0)
+CPU_FEATURE(HW_PAE,             0x00000001, 0, REG_EDX,  6, "pae", NULL, 0)
+CPU_FEATURE(HW_MCE,             0x00000001, 0, REG_EDX,  7, "mce", NULL, 0)
+CPU_FEATURE(HW_CX8,             0x00000001, 0, REG_EDX,  8, "cx8", NULL, 0)
+CPU_FEATURE(HW_APIC,            0x00000001, 0, REG_EDX,  9, "apic", NULL, 0)
+CPU_FEATURE(HW_SEP,             0x00000001, 0, REG_EDX, 11, "sep", NULL, 0)
+CPU_FEATURE(HW_MTRR,            0x00000001, 0, REG_EDX, 12, "mtrr", NULL, 0)
+CPU_FEATURE(HW_PGE,             0x00000001, 0, REG_EDX, 13, "pge", NULL, 0)
+CPU_FEATURE(HW_MCA,             0x00000001, 0, REG_EDX, 14, "mca", NULL, 0)
+CPU_FEATURE(HW_CMOV,            0x00000001, 0, REG_EDX, 15, "cmov", NULL, 0)
+CPU_FEATURE(HW_PAT,             0x00000001, 0, REG_EDX, 16, "pat", NULL, 0)
+CPU_FEATURE(HW_PSE36,           0x00000001, 0, REG_EDX, 17, "pse36", NULL, 0)
+CPU_FEATURE(HW_PSN,             0x00000001, 0, REG_EDX, 18, "psn", NULL, 0)
+CPU_FEATURE(HW_CLFLUSH,         0x00000001, 0, REG_EDX, 19, "clflush", NULL, 0)
+CPU_FEATURE(HW_DS,              0x00000001, 0, REG_EDX, 21, "ds", NULL, 0)
+CPU_FEATURE(HW_ACPI,            0x00000001, 0, REG_EDX, 22, "acpi", NULL, 0)
+CPU_FEATURE(HW_MMX,             0x00000001, 0, REG_EDX, 23, "mmx", "mmx", 3)
+CPU_FEATURE(HW_FXSR,            0x00000001, 0, REG_EDX, 24, "fxsr", "fxsr", 4)
+CPU_FEATURE(HW_SSE,             0x00000001, 0, REG_EDX, 25, "sse", "sse", 3)
+CPU_FEATURE(HW_SSE2,            0x00000001, 0, REG_EDX, 26, "sse2", "sse2", 3)
+CPU_FEATURE(HW_SS,              0x00000001, 0, REG_EDX, 27, "ss", NULL, 0)
+CPU_FEATURE(HW_HTT,             0x00000001, 0, REG_EDX, 28, "ht", NULL, 0)
+CPU_FEATURE(HW_TM,              0x00000001, 0, REG_EDX, 29, "tm", NULL, 0)
+CPU_FEATURE(HW_IA64,            0x00000001, 0, REG_EDX, 30, "ia64", NULL, 0)
+CPU_FEATURE(HW_PBE,             0x00000001, 0, REG_EDX, 31, "pbe", NULL, 0)
+
+/* EAX=80000001h: Extended Processor Info and Feature Bits */
+CPU_FEATURE(HW_SYSCALL,         0x80000001, 0, REG_EDX, 11, "syscall", NULL, 0)
+CPU_FEATURE(HW_MP,              0x80000001, 0, REG_EDX, 19, "mp", NULL, 0)
+CPU_FEATURE(HW_NX,              0x80000001, 0, REG_EDX, 20, "nx", NULL, 0)
+CPU_FEATURE(HW_MMEXT,           0x80000001, 0, REG_EDX, 22, "mmext", NULL, 0)
+CPU_FEATURE(HW_FXSR_OPT,        0x80000001, 0, REG_EDX, 25, "fxsr_opt", NULL, 0)
+CPU_FEATURE(HW_PDPE1GB,         0x80000001, 0, REG_EDX, 26, "pdpe1gb", NULL, 0)
+CPU_FEATURE(HW_RDTSCP,          0x80000001, 0, REG_EDX, 27, "rdtscp", NULL, 0)
+CPU_FEATURE(HW_LM,              0x80000001, 0, REG_EDX, 29, "lm", NULL, 0)
+CPU_FEATURE(HW_3DNOWEXT,        0x80000001, 0, REG_EDX, 30, "3dnowext", "3dnowa", 7)
+CPU_FEATURE(HW_3DNOW,           0x80000001, 0, REG_EDX, 31, "3dnow", "3dnow", 3)
+CPU_FEATURE(HW_LAHF_LM,         0x80000001, 0, REG_ECX,  0, "lahf_lm", "sahf", 4)
+CPU_FEATURE(HW_CMP_LEGACY,      0x80000001, 0, REG_ECX,  1, "cmp_legacy", NULL, 0)
+CPU_FEATURE(HW_SVM,             0x80000001, 0, REG_ECX,  2, "svm", NULL, 0)
+CPU_FEATURE(HW_EXTAPIC,         0x80000001, 0, REG_ECX,  3, "extapic", NULL, 0)
+CPU_FEATURE(HW_CR8_LEGACY,      0x80000001, 0, REG_ECX,  4, "cr8_legacy", NULL, 0)
+CPU_FEATURE(HW_ABM,             0x80000001, 0, REG_ECX,  5, "abm", "lzcnt", 4)
+CPU_FEATURE(HW_SSE4A,           0x80000001, 0, REG_ECX,  6, "sse4a", "sse4a", 4)
+CPU_FEATURE(HW_MISALIGNSSE,     0x80000001, 0, REG_ECX,  7, "misalignsse", NULL, 0)
+CPU_FEATURE(HW_3DNOWPREFETCH,   0x80000001, 0, REG_ECX,  8, "3dnowprefetch", "prfchw", 4)
+CPU_FEATURE(HW_OSVW,            0x80000001, 0, REG_ECX,  9, "osvw", NULL, 0)
+CPU_FEATURE(HW_IBS,             0x80000001, 0, REG_ECX, 10, "ibs", NULL, 0)
+CPU_FEATURE(HW_XOP,             0x80000001, 0, REG_ECX, 11, "xop", "xop", 4)
+CPU_FEATURE(HW_SKINIT,          0x80000001, 0, REG_ECX, 12, "skinit", NULL, 0)
+CPU_FEATURE(HW_WDT,             0x80000001, 0, REG_ECX, 13, "wdt", NULL, 0)
+CPU_FEATURE(HW_LWP,             0x80000001, 0, REG_ECX, 15, "lwp", "lwp", 4)
+CPU_FEATURE(HW_FMA4,            0x80000001, 0, REG_ECX, 16, "fma4", "fma4", 4)
+CPU_FEATURE(HW_TCE,             0x80000001, 0, REG_ECX, 17, "tce", NULL, 0)
+CPU_FEATURE(HW_NODEID_MSR,      0x80000001, 0, REG_ECX, 19, "nodeid_msr", NULL, 0)
+CPU_FEATURE(HW_TBM,             0x80000001, 0, REG_ECX, 21, "tbm", "tbm", 4)
+CPU_FEATURE(HW_TOPOEXT,         0x80000001, 0, REG_ECX, 22, "topoext", NULL, 0)
+CPU_FEATURE(HW_PERFCTR_CORE,    0x80000001, 0, REG_ECX, 23, "perfctr_core", NULL, 0)
+CPU_FEATURE(HW_PERFCTR_NB,      0x80000001, 0, REG_ECX, 24, "perfctr_nb", NULL, 0)
+CPU_FEATURE(HW_DBX,             0x80000001, 0, REG_ECX, 26, "dbx", NULL, 0)
+CPU_FEATURE(HW_PERFTSC,         0x80000001, 0, REG_ECX, 27, "perftsc", NULL, 0)
+CPU_FEATURE(HW_PCX_L2I,         0x80000001, 0, REG_ECX, 28, "pcx_l2i", NULL, 0)
+CPU_FEATURE(HW_MWAITX,          0x80000001, 0, REG_ECX, 29, "mwaitx", "mwaitx", 5)
+
+/* EAX=1: Processor Info and Feature Bits (ECX) */
+CPU_FEATURE(HW_SSE3,            0x00000001, 0, REG_ECX,  0, "sse3", "sse3", 3)
+CPU_FEATURE(HW_PCLMUL,          0x00000001, 0, REG_ECX,  1, "pclmul", "pclmul", 4)
+CPU_FEATURE(HW_DTES64,          0x00000001, 0, REG_ECX,  2, "dtes64", NULL, 0)
+CPU_FEATURE(HW_MONITOR,         0x00000001, 0, REG_ECX,  3, "monitor", NULL, 0)
+CPU_FEATURE(HW_DS_CPL,          0x00000001, 0, REG_ECX,  4, "ds_cpl", NULL, 0)
+CPU_FEATURE(HW_VMX,             0x00000001, 0, REG_ECX,  5, "vmx", NULL, 0)
+CPU_FEATURE(HW_SMX,             0x00000001, 0, REG_ECX,  6, "smx", NULL, 0)
+CPU_FEATURE(HW_EST,             0x00000001, 0, REG_ECX,  7, "est", NULL, 0)
+CPU_FEATURE(HW_TM2,             0x00000001, 0, REG_ECX,  8, "tm2", NULL, 0)
+CPU_FEATURE(HW_SSSE3,           0x00000001, 0, REG_ECX,  9, "ssse3", "ssse3", 4)
+CPU_FEATURE(HW_CNXT_ID,         0x00000001, 0, REG_ECX, 10, "cnxt_id", NULL, 0)
+CPU_FEATURE(HW_SDBG,            0x00000001, 0, REG_ECX, 11, "sdbg", NULL, 0)
+CPU_FEATURE(HW_FMA,             0x00000001, 0, REG_ECX, 12, "fma", "fma", 4)
+CPU_FEATURE(HW_CX16,            0x00000001, 0, REG_ECX, 13, "cx16", "cx16", 4)
+CPU_FEATURE(HW_XTPR,            0x00000001, 0, REG_ECX, 14, "xtpr", NULL, 0)
+CPU_FEATURE(HW_PDCM,            0x00000001, 0, REG_ECX, 15, "pdcm", NULL, 0)
+CPU_FEATURE(HW_PCID,            0x00000001, 0, REG_ECX, 17, "pcid", NULL, 0)
+CPU_FEATURE(HW_DCA,             0x00000001, 0, REG_ECX, 18, "dca", NULL, 0)
+CPU_FEATURE(HW_SSE41,           0x00000001, 0, REG_ECX, 19, "sse41", "sse4.1", 4)
+CPU_FEATURE(HW_SSE42,           0x00000001, 0, REG_ECX, 20, "sse42", "sse4.2", 4)
+CPU_FEATURE(HW_X2APIC,          0x00000001, 0, REG_ECX, 21, "x2apic", NULL, 0)
+CPU_FEATURE(HW_MOVBE,           0x00000001, 0, REG_ECX, 22, "movbe", "movbe", 4)
+CPU_FEATURE(HW_POPCNT,          0x00000001, 0, REG_ECX, 23, "popcnt", "popcnt", 4)
+CPU_FEATURE(HW_TSC_DEADLINE,    0x00000001, 0, REG_ECX, 24, "tsc_deadline", NULL, 0)
+CPU_FEATURE(HW_AES,             0x00000001, 0, REG_ECX, 25, "aes", "aes", 4)
+CPU_FEATURE(HW_XSAVE,           0x00000001, 0, REG_ECX, 26, "xsave", "xsave", 4)
+CPU_FEATURE(HW_OSXSAVE,         0x00000001, 0, REG_ECX, 27, "osxsave", NULL, 0)
+CPU_FEATURE(HW_AVX,             0x00000001, 0, REG_ECX, 28, "avx", "avx", 4)
+CPU_FEATURE(HW_F16C,            0x00000001, 0, REG_ECX, 29, "f16c", "f16c", 4)
+CPU_FEATURE(HW_RDRND,           0x00000001, 0, REG_ECX, 30, "rdrnd", "rdrnd", 4)
+CPU_FEATURE(HW_HYPERVISOR,      0x00000001, 0, REG_ECX, 31, "hypervisor", NULL, 0)
+
+/* extended feature flags EAX=7 */
+CPU_FEATURE(HW_FSGSBASE,        0x00000007, 0, REG_EBX,  0, "fsgsbase", "fsgsbase", 4)
+CPU_FEATURE(HW_SGX,             0x00000007, 0, REG_EBX,  2, "sgx", "sgx", 7)
+CPU_FEATURE(HW_BMI,             0x00000007, 0, REG_EBX,  3, "bmi", "bmi", 4)
+CPU_FEATURE(HW_HLE,             0x00000007, 0, REG_EBX,  4, "hle", "hle", 4)
+CPU_FEATURE(HW_AVX2,            0x00000007, 0, REG_EBX,  5, "avx2", "avx2", 4)
+CPU_FEATURE(HW_SMEP,            0x00000007, 0, REG_EBX,  7, "smep", NULL, 0)
+CPU_FEATURE(HW_BMI2,            0x00000007, 0, REG_EBX,  8, "bmi2", "bmi2", 4)
+CPU_FEATURE(HW_ERMS,            0x00000007, 0, REG_EBX,  9, "erms", NULL, 0)
+CPU_FEATURE(HW_INVPCID,         0x00000007, 0, REG_EBX, 10, "invpcid", NULL, 0)
+CPU_FEATURE(HW_RTM,             0x00000007, 0, REG_EBX, 11, "rtm", "rtm", 4)
+CPU_FEATURE(HW_PQM,             0x00000007, 0, REG_EBX, 12, "pqm", NULL, 0)
+CPU_FEATURE(HW_MPX,             0x00000007, 0, REG_EBX, 14, "mpx", "mpx", 5)
+CPU_FEATURE(HW_PQE,             0x00000007, 0, REG_EBX, 15, "pqe", NULL, 0)
+CPU_FEATURE(HW_AVX512F,         0x00000007, 0, REG_EBX, 16, "avx512f", "avx512f", 4)
+CPU_FEATURE(HW_AVX512DQ,        0x00000007, 0, REG_EBX, 17, "avx512dq", "avx512dq", 5)
+CPU_FEATURE(HW_RDSEED,          0x00000007, 0, REG_EBX, 18, "rdseed", "rdseed", 4)
+CPU_FEATURE(HW_ADX,             0x00000007, 0, REG_EBX, 19, "adx", "adx", 4)
+CPU_FEATURE(HW_SMAP,            0x00000007, 0, REG_EBX, 20, "smap", NULL, 0)
+CPU_FEATURE(HW_AVX512IFMA,      0x00000007, 0, REG_EBX, 21, "avx512ifma", "avx512ifma", 5)
+CPU_FEATURE(HW_PCOMMIT,         0x00000007, 0, REG_EBX, 22, "pcommit", NULL, 0)
+CPU_FEATURE(HW_CLFLUSHOPT,      0x00000007, 0, REG_EBX, 23, "clflushopt", "clflushopt", 5)
+CPU_FEATURE(HW_CLWB,            0x00000007, 0, REG_EBX, 24, "clwb", "clwb", 5)
+CPU_FEATURE(HW_INTEL_PT,        0x00000007, 0, REG_EBX, 25, "intel_pt", NULL, 0)
+CPU_FEATURE(HW_AVX512PF,        0x00000007, 0, REG_EBX, 26, "avx512pf", "avx512pf", 4)
+CPU_FEATURE(HW_AVX512ER,        0x00000007, 0, REG_EBX, 27, "avx512er", "avx512er", 4)
+CPU_FEATURE(HW_AVX512CD,        0x00000007, 0, REG_EBX, 28, "avx512cd", "avx512cd", 4)
+CPU_FEATURE(HW_SHA,             0x00000007, 0, REG_EBX, 29, "sha", "sha", 4)
+CPU_FEATURE(HW_AVX512BW,        0x00000007, 0, REG_EBX, 30, "avx512bw", "avx512bw", 5)
+CPU_FEATURE(HW_AVX512VL,        0x00000007, 0, REG_EBX, 31, "avx512vl", "avx512vl", 5)
+CPU_FEATURE(HW_PREFETCHWT1,     0x00000007, 0, REG_ECX,  0, "prefetchwt1", "prefetchwt1", 5)
+CPU_FEATURE(HW_AVX512VBMI,      0x00000007, 0, REG_ECX,  1, "avx512vbmi", "avx512vbmi", 5)
+CPU_FEATURE(HW_UMIP,            0x00000007, 0, REG_ECX,  2, "umip", NULL, 0)
+CPU_FEATURE(HW_PKU,             0x00000007, 0, REG_ECX,  3, "pku", "pku", 6)
+CPU_FEATURE(HW_OSPKE,           0x00000007, 0, REG_ECX,  4, "ospke", NULL, 0)
+CPU_FEATURE(HW_WAITPKG,         0x00000007, 0, REG_ECX,  5, "waitpkg", "waitpkg", 9)
+CPU_FEATURE(HW_AVX512VBMI2,     0x00000007, 0, REG_ECX,  6, "avx512vbmi2", "avx512vbmi2", 8)
+CPU_FEATURE(HW_SHSTK,           0x00000007, 0, REG_ECX,  7, "shstk", "shstk", 8)
+CPU_FEATURE(HW_GFNI,            0x00000007, 0, REG_ECX,  8, "gfni", "gfni", 8)
+CPU_FEATURE(HW_VAES,            0x00000007, 0, REG_ECX,  9, "vaes", "vaes", 8)
+CPU_FEATURE(HW_VPCLMULQDQ,      0x00000007, 0, REG_ECX, 10, "vpclmulqdq", "vpclmulqdq", 8)
+CPU_FEATURE(HW_AVX512VNNI,      0x00000007, 0, REG_ECX, 11, "avx512vnni", "avx512vnni", 8)
+CPU_FEATURE(HW_AVX512BITALG,    0x00000007, 0, REG_ECX, 12, "avx512bitalg", "avx512bitalg", 8)
+CPU_FEATURE(HW_AVX512VPOPCNTDQ, 0x00000007, 0, REG_ECX, 14, "avx512vpopcntdq", "avx512vpopcntdq", 7)
+CPU_FEATURE(HW_LA57,            0x00000007, 0, REG_ECX, 16, "la57", NULL, 0)
+CPU_FEATURE(HW_RDPID,           0x00000007, 0, REG_ECX, 22, "rdpid", "rdpid", 8)
+CPU_FEATURE(HW_KL,              0x00000007, 0, REG_ECX, 23, "kl", "kl", 11)
+CPU_FEATURE(HW_CLDEMOTE,        0x00000007, 0, REG_ECX, 25, "cldemote", "cldemote", 9)
+CPU_FEATURE(HW_MOVDIRI,         0x00000007, 0, REG_ECX, 27, "movdiri", "movdiri", 9)
+CPU_FEATURE(HW_MOVDIR64B,       0x00000007, 0, REG_ECX, 28, "movdir64b", "movdir64b", 9)
+CPU_FEATURE(HW_ENQCMD,          0x00000007, 0, REG_ECX, 29, "enqcmd", "enqcmd", 10)
+CPU_FEATURE(HW_SGX_LC,          0x00000007, 0, REG_ECX, 30, "sgx_lc", NULL, 0)
+CPU_FEATURE(HW_AVX5124VNNIW,    0x00000007, 0, REG_EDX,  2, "avx5124vnniw", "avx5124vnniw", 7)
+CPU_FEATURE(HW_AVX5124FMAPS,    0x00000007, 0, REG_EDX,  3, "avx5124fmaps", "avx5124fmaps", 7)
+CPU_FEATURE(HW_FSRM,            0x00000007, 0, REG_EDX,  4, "fsrm", NULL, 0)
+CPU_FEATURE(HW_UINTR,           0x00000007, 0, REG_EDX,  5, "uintr", "uintr", 11)
+CPU_FEATURE(HW_AVX512VP2INTERSECT, 0x00000007, 0, REG_EDX,  8, "avx512vp2intersect", "avx512vp2intersect", 10)
+CPU_FEATURE(HW_SERIALIZE,       0x00000007, 0, REG_EDX, 14, "serialize", "serialize", 11)
+CPU_FEATURE(HW_HYBRID,          0x00000007, 0, REG_EDX, 15, "hybrid", NULL, 0)
+CPU_FEATURE(HW_TSXLDTRK,        0x00000007, 0, REG_EDX, 16, "tsxldtrk", "tsxldtrk", 11)
+CPU_FEATURE(HW_PCONFIG,         0x00000007, 0, REG_EDX, 18, "pconfig", "pconfig", 8)
+CPU_FEATURE(HW_IBT,             0x00000007, 0, REG_EDX, 20, "ibt", NULL, 0)
+CPU_FEATURE(HW_AMX_BF16,        0x00000007, 0, REG_EDX, 22, "amx_bf16", "amx-bf16", 11)
+CPU_FEATURE(HW_AVX512FP16,      0x00000007, 0, REG_EDX, 23, "avx512fp16", "avx512fp16", 12)
+CPU_FEATURE(HW_AMX_TILE,        0x00000007, 0, REG_EDX, 24, "amx_tile", "amx-tile", 11)
+CPU_FEATURE(HW_AMX_INT8,        0x00000007, 0, REG_EDX, 25, "amx_int8", "amx-int8", 11)
+
+/* Structured Extended Feature Flags Sub-leaf (EAX = 07H, ECX = 1) */
+CPU_FEATURE(HW_SHA512,          0x00000007, 1, REG_EAX,  0, "sha512", "sha512", 14)
+CPU_FEATURE(HW_SM3,             0x00000007, 1, REG_EAX,  1, "sm3", "sm3", 14)
+CPU_FEATURE(HW_SM4,             0x00000007, 1, REG_EAX,  2, "sm4", "sm4", 14)
+CPU_FEATURE(HW_RAOINT,          0x00000007, 1, REG_EAX,  3, "raoint", "raoint", 13)
+CPU_FEATURE(HW_AVXVNNI,         0x00000007, 1, REG_EAX,  4, "avxvnni", "avxvnni", 11)
+CPU_FEATURE(HW_AVX512BF16,      0x00000007, 1, REG_EAX,  5, "avx512bf16", "avx512bf16", 10)
+CPU_FEATURE(HW_CMPCCXADD,       0x00000007, 1, REG_EAX,  7, "cmpccxadd", "cmpccxadd", 13)
+CPU_FEATURE(HW_FZLRM,           0x00000007, 1, REG_EAX, 10, "fzlrm", NULL, 0)
+CPU_FEATURE(HW_FSRS,            0x00000007, 1, REG_EAX, 11, "fsrs", NULL, 0)
+CPU_FEATURE(HW_FSRCS,           0x00000007, 1, REG_EAX, 12, "fsrcs", NULL, 0)
+CPU_FEATURE(HW_AMX_FP16,        0x00000007, 1, REG_EAX, 21, "amx_fp16", "amx-fp16", 13)
+CPU_FEATURE(HW_HRESET,          0x00000007, 1, REG_EAX, 22, "hreset", "hreset", 11)
+CPU_FEATURE(HW_AVXIFMA,         0x00000007, 1, REG_EAX, 23, "avxifma", "avxifma", 13)
+CPU_FEATURE(HW_LAM,             0x00000007, 1, REG_EAX, 26, "lam", NULL, 0)
+CPU_FEATURE(HW_AVXVNNIINT8,     0x00000007, 1, REG_EDX,  4, "avxvnniint8", "avxvnniint8", 13)
+CPU_FEATURE(HW_AVXNECONVERT,    0x00000007, 1, REG_EDX,  5, "avxneconvert", "avxneconvert", 13)
+CPU_FEATURE(HW_AMX_COMPLEX,     0x00000007, 1, REG_EDX,  8, "amx_complex", "amx-complex", 14)
+CPU_FEATURE(HW_AVXVNNIINT16,    0x00000007, 1, REG_EDX, 10, "avxvnniint16", "avxvnniint16", 14)
+CPU_FEATURE(HW_PREFETCHI,       0x00000007, 1, REG_EDX, 14, "prefetchi", "prefetchi", 13)
+CPU_FEATURE(HW_USER_MSR,        0x00000007, 1, REG_EDX, 15, "user_msr", "usermsr", 14)
+CPU_FEATURE(HW_AVX10,           0x00000007, 1, REG_EDX, 19, "avx10", NULL, 0)
+
+/* Advanced Power Management Information, CPUID level 0x80000007 (EDX) */
+CPU_FEATURE(HW_INVTSC,          0x80000007, 0, REG_EDX,  8, "invtsc", NULL, 0)
+
+/* AMD-defined CPU features, CPUID level 0x80000008 (EBX) */
+CPU_FEATURE(HW_CLZERO,          0x80000008, 0, REG_EBX,  0, "clzero", "clzero", 7)
+CPU_FEATURE(HW_RDPRU,           0x80000008, 0, REG_EBX,  4, "rdpru", NULL, 0)
+CPU_FEATURE(HW_WBNOINVD,        0x80000008, 0, REG_EBX,  9, "wbnoinvd", "wbnoinvd", 9)
+
+/* Processor Extended State Enumeration Sub-leaf (EAX = 0DH, ECX = 1) */
+CPU_FEATURE(HW_XSAVEOPT,        0x0000000d, 1, REG_EAX,  0, "xsaveopt", "xsaveopt", 4)
+CPU_FEATURE(HW_XSAVEC,          0x0000000d, 1, REG_EAX,  1, "xsavec", "xsavec", 5)
+CPU_FEATURE(HW_XGETBV,          0x0000000d, 1, REG_EAX,  2, "xgetbv", NULL, 0)
+CPU_FEATURE(HW_XSAVES,          0x0000000d, 1, REG_EAX,  3, "xsaves", "xsaves", 5)
+CPU_FEATURE(HW_XFD,             0x0000000d, 1, REG_EAX,  4, "xfd", NULL, 0)
+
+/* Intel Processor Trace Enumeration Main Leaf (EAX = 14H, ECX = 0) */
+CPU_FEATURE(HW_PTWRITE,         0x00000014, 0, REG_EBX,  4, "ptwrite", "ptwrite", 9)
+
+/* Key Locker Leaf (EAX = 19H) */
+CPU_FEATURE(HW_AESKLE,          0x00000019, 0, REG_EBX,  0, "aeskle", NULL, 0)
+CPU_FEATURE(HW_WIDEKL,          0x00000019, 0, REG_EBX,  2, "widekl", "widekl", 11)
@@ -0,0 +1,98 @@
+/* cpu_internal.h
+
+written by: Oliver Cordes 2019-07-01
+changed by: Oliver Cordes 2019-07-01
+
+*/
+
+/* library internal functions, shared between the translation
+   units of libdetectcpu, not installed
+*/
+
+#ifndef CPU_INTERNAL_H
+#define CPU_INTERNAL_H
+
+#include "detectcpu.h"
+
+
+/* cpuidsrc.c, the CPUID source: hardware or a replayed dump */
+
+void cpuid(int info[4], int InfoType);
+void cpuidcx(int info[4], int InfoType, int cx);
+uint64_t xgetbv(unsigned int index);
+
+#define CPUID_MAX_ENTRIES 1024
+
+typedef struct {
+  unsigned int leaf;
+  unsigned int subleaf;
+  int          info[4];
+} _cpuid_entry;
+
+typedef struct {
+  int          n;
+  uint64_t     xcr0;
+  _cpuid_entry entries[CPUID_MAX_ENTRIES];
+} _cpuid_dump;
+
+void dump_cpuid(const _cpuid_dump *dump, int info[4], unsigned int leaf,
+                unsigned int subleaf);
+int  load_dump(const char *filename, _cpuid_dump *dump);
+int  cpuid_replaying(void);
+int  cpuid_probe_faulting(void);
+
+
+/* one entry of the feature specification, see cpu_features.h */
+
+typedef struct {
+  unsigned int  leaf;
+  unsigned int  subleaf;
+  int           reg;
+  int           bit;
+  char         *name;
+  char         *gcc;        /* gcc -m option name or NULL */
+  int           gcc_release; /* first gcc major release knowing -m<gcc> */
+} _cpu_feature;
+
+
+/* libdetectcpu.c */
+extern _cpu_feature cpu_feature_spec[HW_NUM_FEATURES];
+
+int         str_equal(const char *a, const char *b);
+int         cpuid_leaf_valid(unsigned int leaf);
+const char *get_arch_name(int arch);
+int         get_arch_gcc(int arch);
+void        get_arch_features(int arch, _cpu_featureset *set);
+void        get_arch_features_for(int arch, int gcc, _cpu_featureset *set);
+int         featureset_count(const _cpu_featureset *set);
+void        decode_cpu_features(_cpu_featureset *set);
+void        apply_xstate_gates(_cpu_featureset *set, uint64_t xcr0);
+unsigned int get_cpu_signature(void);
+void        get_cpu_brand(char *brand);
+int         get_cpu_type(const char *vendor);
+int         get_gcc_arch_type(int cpu_type, const _cpu_featureset *features);
+int         get_x86_64_level(const _cpu_featureset *features);
+void        detect_cpu(void);
+void        decode_host(const _cpuid_dump *dump, _cpu_host *host);
+
+/* models.c */
+void        decode_signature(unsigned int signature, unsigned int *family,
+                             unsigned int *model, unsigned int *stepping);
+int         get_model_arch(int cpu_type, unsigned int signature);
+int         refine_arch(int arch, int model_arch,
+                        const _cpu_featureset *features);
+
+/* topology.c */
+int         get_core_type(unsigned int *native_model);
+
+/* cache.c */
+void        get_cpu_caches(void);
+
+/* percpu.c */
+typedef void (*_cpu_probe)(int index, int cpu, void *arg);
+
+int         get_cpu_list(int *cpus, int max);
+int         parse_cpu_list(const char *list, int *cpus, int max);
+int         run_on_cpus(const int *cpus, int n, _cpu_probe probe, void *arg);
+
+#endif
@@ -0,0 +1,405 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "cpu_internal.h"
+
+
+/* cpuidsrc.c
+
+written by: Oliver Cordes 2019-07-01
+changed by: Oliver Cordes 2019-07-01
+
+*/
+
+
+/* the CPUID source of the library: either the hardware or a dump of
+   another processor which was recorded with dcpu_cpuid_record().
+   Replaying a dump lets the whole detection run for any processor on
+   any machine.
+
+   dump format, one line per leaf/subleaf, all values in hex:
+
+     # comment
+     xcr0 <xcr0>
+     <leaf> <subleaf> <eax> <ebx> <ecx> <edx>
+*/
+
+
+/* the hardware access, Windows has intrinsics for all of them */
+
+#ifdef _WIN32
+
+#include <intrin.h>
+#define hw_cpuidcx(info, x, cx)  __cpuidex(info, x, cx)
+#define hw_xgetbv(index)         _xgetbv(index)
+
+#else
+
+/*  GCC Intrinsics */
+#include <cpuid.h>
+static void hw_cpuidcx(int info[4], int InfoType, int cx)
+{
+    __cpuid_count(InfoType, cx, info[0], info[1], info[2], info[3]);
+}
+
+#if defined(__linux__) && defined(__x86_64__)
+#include <asm/prctl.h>
+#include <sys/syscall.h>
+#endif
+
+static uint64_t hw_xgetbv(unsigned int index)
+{
+    unsigned int eax, edx;
+
+    __asm__ __volatile__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(index));
+    return ((uint64_t)edx << 32) | eax;
+}
+
+#endif
+
+
+#define CPUID_MAX_SUBLEAF 64
+
+
+static _cpuid_dump replay;
+static int         replay_active = 0;
+static int         hw_faulting = 0;
+
+
+/* leaves which depend on the subleaf in ECX, all other leaves ignore
+   ECX and are only recorded for subleaf 0
+*/
+
+#define subleaf_nonzero  0     /* all non-empty subleaves */
+#define subleaf_cache    1     /* until the cache type is 0 */
+#define subleaf_level    2     /* until the level type is 0 */
+
+typedef struct {
+  unsigned int leaf;
+  int          end;
+} _subleaf_leaf;
+
+static _subleaf_leaf subleaf_leaves[] = {
+  {0x00000004, subleaf_cache},
+  {0x00000007, subleaf_nonzero},
+  {0x0000000b, subleaf_level},
+  {0x0000000d, subleaf_nonzero},
+  {0x0000000f, subleaf_nonzero},
+  {0x00000010, subleaf_nonzero},
+  {0x00000012, subleaf_nonzero},
+  {0x00000014, subleaf_nonzero},
+  {0x00000017, subleaf_nonzero},
+  {0x00000018, subleaf_nonzero},
+  {0x0000001d, subleaf_nonzero},
+  {0x0000001f, subleaf_level},
+  {0x00000020, subleaf_nonzero},
+  {0x8000001d, subleaf_cache},
+  {0x80000020, subleaf_nonzero},
+  {0, 0}
+};
+
+
+static _subleaf_leaf *find_subleaf_leaf(unsigned int leaf)
+{
+  _subleaf_leaf *s;
+
+  for (s = subleaf_leaves; s->leaf != 0; ++s)
+    if (s->leaf == leaf)
+      return s;
+
+  return NULL;
+}
+
+
+/* dump_cpuid
+
+looks up a leaf/subleaf in a dump, leaves without subleaves
+answer every subleaf with subleaf 0, missing leaves read as 0,
+a NULL dump asks the current CPUID source
+*/
+
+void dump_cpuid(const _cpuid_dump *dump, int info[4], unsigned int leaf,
+                unsigned int subleaf)
+{
+  int i;
+
+  if (dump == NULL)
+  {
+    cpuidcx(info, (int)leaf, (int)subleaf);
+    return;
+  }
+
+  if (find_subleaf_leaf(leaf) == NULL)
+    subleaf = 0;
+
+  for (i = 0; i < dump->n; ++i)
+    if ((dump->entries[i].leaf == leaf)
+        && (dump->entries[i].subleaf == subleaf))
+    {
+      info[0] = dump->entries[i].info[0];
+      info[1] = dump->entries[i].info[1];
+      info[2] = dump->entries[i].info[2];
+      info[3] = dump->entries[i].info[3];
+      return;
+    }
+
+  info[0] = info[1] = info[2] = info[3] = 0;
+}
+
+
+void cpuid(int info[4], int InfoType)
+{
+  cpuidcx(info, InfoType, 0);
+}
+
+
+void cpuidcx(int info[4], int InfoType, int cx)
+{
+  if (replay_active)
+    dump_cpuid(&replay, info, (unsigned int)InfoType, (unsigned int)cx);
+  else if (hw_faulting)
+    info[0] = info[1] = info[2] = info[3] = 0;
+  else
+    hw_cpuidcx(info, InfoType, cx);
+}
+
+
+uint64_t xgetbv(unsigned int index)
+{
+  if (replay_active)
+    return (index == 0) ? replay.xcr0 : 0;
+
+  return hw_xgetbv(index);
+}
+
+
+/* cpuid_probe_faulting
+
+checks whether the kernel made CPUID fault for this process
+(arch_prctl(ARCH_SET_CPUID, 0), e.g. by a record/replay debugger),
+a CPUID would raise SIGSEGV then and the hardware reads as all 0.
+The syscall is issued directly, the check runs inside of ifunc
+resolvers. Returns 1 if CPUID faults.
+*/
+
+int cpuid_probe_faulting(void)
+{
+#if defined(__linux__) && defined(__x86_64__) && defined(ARCH_GET_CPUID)
+  long ret;
+
+  __asm__ __volatile__("syscall"
+                       : "=a"(ret)
+                       : "0"((long)SYS_arch_prctl), "D"((long)ARCH_GET_CPUID),
+                         "S"(0L)
+                       : "rcx", "r11", "memory");
+
+  /* 0 = faulting, 1 = enabled, < 0 = not supported by the kernel */
+  hw_faulting = (ret == 0);
+#else
+  hw_faulting = 0;
+#endif
+
+  return hw_faulting;
+}
+
+
+/* cpuid_replaying
+
+returns 1 if the CPUID source is a dump, measurements of the local
+hardware don't belong to it then
+*/
+
+int cpuid_replaying(void)
+{
+  return replay_active;
+}
+
+
+/* record_range
+
+writes all non-empty leaves from first up to the maximum leaf
+reported in EAX of the first leaf
+*/
+
+static void record_range(FILE *f, unsigned int first)
+{
+  _subleaf_leaf *s;
+  unsigned int   leaf, last, sub;
+  int            info[4];
+
+  cpuid(info, first);
+  last = (unsigned int)info[0];
+  if ((last < first) || (last - first > 0xff))
+    last = first;
+
+  for (leaf = first; leaf <= last; ++leaf)
+  {
+    s = find_subleaf_leaf(leaf);
+    for (sub = 0; sub < CPUID_MAX_SUBLEAF; ++sub)
+    {
+      cpuidcx(info, leaf, sub);
+
+      /* missing entries replay as 0 */
+      if ((info[0] | info[1] | info[2] | info[3]) != 0)
+        fprintf(f, "%08x %02x %08x %08x %08x %08x\n", leaf, sub,
+                (unsigned int)info[0], (unsigned int)info[1],
+                (unsigned int)info[2], (unsigned int)info[3]);
+
+      if ((s == NULL)
+          || ((s->end == subleaf_cache) && ((info[0] & 0x1f) == 0))
+          || ((s->end == subleaf_level) && (((info[2] >> 8) & 0xff) == 0)))
+        break;
+    }
+  }
+}
+
+
+/* dcpu_cpuid_record
+
+writes all leaves of the current CPUID source to a dump file,
+returns 0 on success and -1 if the file cannot be written
+*/
+
+int dcpu_cpuid_record(const char *filename)
+{
+  FILE *f;
+  int   info[4];
+  int   ret;
+
+  dcpu_init();
+
+  f = fopen(filename, "w");
+  if (f == NULL)
+    return -1;
+
+  fprintf(f, "# detectcpu cpuid dump\n");
+  fprintf(f, "# %s %s\n", dcpu_cpu.vendor, dcpu_cpu.brand);
+  fprintf(f, "xcr0 %016llx\n", (unsigned long long)dcpu_cpu.xcr0);
+
+  record_range(f, 0x00000000);
+
+  /* hypervisor leaves are only valid inside of a guest */
+  cpuid(info, 0x00000001);
+  if ((info[2] >> 31) & 1)
+    record_range(f, 0x40000000);
+  if (dcpu_cpu.hypervisor_leaf > 0x40000000)
+    record_range(f, dcpu_cpu.hypervisor_leaf);
+
+  record_range(f, 0x80000000);
+
+  ret = ferror(f) ? -1 : 0;
+  if (fclose(f) != 0)
+    ret = -1;
+
+  return ret;
+}
+
+
+/* load_dump
+
+reads a dump file, returns 0 on success and -1 if the file cannot
+be read or contains a syntax error
+*/
+
+int load_dump(const char *filename, _cpuid_dump *dump)
+{
+  FILE               *f;
+  char                line[256];
+  unsigned int        v[6];
+  unsigned long long  xcr0 = 0;
+  int                 ret = 0;
+
+  dump->n = 0;
+  dump->xcr0 = 0;
+
+  f = fopen(filename, "r");
+  if (f == NULL)
+    return -1;
+
+  while (fgets(line, sizeof(line), f) != NULL)
+  {
+    if ((line[0] == '#') || (line[0] == '\n') || (line[0] == '\0'))
+      continue;
+
+    if (sscanf(line, "xcr0 %llx", &xcr0) == 1)
+      continue;
+
+    if ((sscanf(line, "%x %x %x %x %x %x", &v[0], &v[1], &v[2], &v[3],
+                &v[4], &v[5]) != 6)
+        || (dump->n == CPUID_MAX_ENTRIES))
+    {
+      ret = -1;
+      break;
+    }
+
+    dump->entries[dump->n].leaf = v[0];
+    dump->entries[dump->n].subleaf = v[1];
+    dump->entries[dump->n].info[0] = (int)v[2];
+    dump->entries[dump->n].info[1] = (int)v[3];
+    dump->entries[dump->n].info[2] = (int)v[4];
+    dump->entries[dump->n].info[3] = (int)v[5];
+    ++dump->n;
+  }
+  fclose(f);
+
+  if ((ret == 0) && (dump->n == 0))
+    ret = -1;
+
+  if (ret != 0)
+    dump->n = 0;
+  dump->xcr0 = (uint64_t)xcr0;
+
+  return ret;
+}
+
+
+/* dcpu_cpuid_replay
+
+switches the CPUID source to a dump file and repeats the detection,
+NULL switches back to the hardware. Must not run concurrently with
+other library calls. Returns 0 on success, -1 if the dump cannot be
+read, the hardware is used in that case
+*/
+
+int dcpu_cpuid_replay(const char *filename)
+{
+  int ret = 0;
+
+  dcpu_init();
+
+  replay_active = 0;
+  if (filename != NULL)
+  {
+    ret = load_dump(filename, &replay);
+    replay_active = (ret == 0);
+  }
+
+  detect_cpu();
+
+  return ret;
+}
+
+
+/* dcpu_cpuid_host
+
+classifies the processor of a dump file without replaying it,
+returns 0 on success and -1 if the dump cannot be read
+*/
+
+int dcpu_cpuid_host(const char *filename, _cpu_host *host)
+{
+  _cpuid_dump *dump;
+  int          ret;
+
+  dump = (_cpuid_dump *)malloc(sizeof(_cpuid_dump));
+  if (dump == NULL)
+    return -1;
+
+  ret = load_dump(filename, dump);
+  if (ret == 0)
+    decode_host(dump, host);
+
+  free(dump);
+
+  return ret;
+}
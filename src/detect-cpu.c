@@ -2,6 +2,13 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <getopt.h>
+
+#include "detectcpu.h"
+#include "writer.h"
+#include "fleet.h"
+#include "exports.h"
+#include "launch.h"
 
 
 /* detect-cpu.c
@@ -17,1120 +24,1372 @@ changed by: Oliver Cordes 2019-07-01
 #define __copyright__ "(C) Copyright 2019"
 
 
-/* this code is heavily inspired by
-  https://github.com/Mysticial/FeatureDetector
-*/
+#define MAX_CPUS 1024
+
 
-/* technical information about the cpuid and feature
-  extraction one can get from:
+/* the effective features, if used (--effective or CPUID faults) */
+static _cpu_effective effective;
+static int            effective_used = 0;
 
-  https://dox.ipxe.org/cpuid_8h_source.html
-  https://hjlebbink.github.io/x86doc/html/CPUID.html
+
+/* the detection itself is done in the libdetectcpu library,
+   see libdetectcpu.c and detectcpu.h
 */
 
-/* tranlating the CPU features into gcc ARCH definitions
-  based on this document:
 
-  https://gcc.gnu.org/onlinedocs/gcc/x86-Options.html
+void report_cpu_data(void)
+{
+  const _cpu_info *info = dcpu_info();
+  unsigned int     family, model, stepping;
+
+  printf("Vendor         : %s\n", info->vendor);
+  printf("Brand          : %s\n", info->brand);
+  printf("cpuid level    : 0x%x\n", info->cpuid_level);
+  printf("cpuid ext level: 0x%x\n", info->cpuid_ext_level);
+  dcpu_signature(info->signature, &family, &model, &stepping);
+  printf("Family/model   : 0x%x/0x%x stepping %u\n", family, model, stepping);
+  printf("Arch           : %s\n", dcpu_arch());
+  printf("Tune           : %s\n", dcpu_tune());
+  printf("x86-64 level   : %s\n", dcpu_level());
+  printf("XCR0           : 0x%llx\n", (unsigned long long)info->xcr0);
+  if (effective_used)
+    printf("Features       : %s\n", effective.cpuid_usable
+           ? "effective (CPUID and kernel)" : "kernel (CPUID faults)");
+  if (dcpu_hypervisor() != NULL)
+    printf("Hypervisor     : %s (%s, max leaf 0x%x)\n", dcpu_hypervisor(),
+           info->hypervisor, info->hypervisor_level);
+  if (info->amx_tiles > 0)
+    printf("AMX tiles      : %d x %d rows x %d bytes\n", info->amx_tiles,
+           info->amx_rows, info->amx_bytes_per_row);
+}
+
+
+/* cpu_arch_type
 
+prints the gcc arch, for gcc > 0 the best one this gcc release knows
 */
 
-/* define some cpuid calls for any OS */
+void cpu_arch_type(int gcc)
+{
+  printf("%s\n", dcpu_arch_name(dcpu_gcc_arch(dcpu_cpu.arch, gcc)));
+}
+
+
+void print_size(unsigned long size)
+{
+  if ((size >= 1024UL * 1024UL) && ((size % (1024UL * 1024UL)) == 0))
+    printf("%lu MB", size / (1024UL * 1024UL));
+  else
+    printf("%lu KB", size / 1024UL);
+}
 
-#ifdef _WIN32
 
-/*  Windows */
-#define cpuid(info, x)    __cpuidex(info, x, 0)
+void report_caches(void)
+{
+  static const char *type_names[] = { "", "d", "i", "" };
+  const _cpu_cache *caches;
+  int               n, i;
 
-#else
+  caches = dcpu_caches(&n);
 
-/*  GCC Intrinsics */
-#include <cpuid.h>
-void cpuid(int info[4], int InfoType){
-    __cpuid_count(InfoType, 0, info[0], info[1], info[2], info[3]);
+  for (i = 0; i < n; ++i)
+  {
+    printf("L%d%s cache%*s: ", caches[i].level, type_names[caches[i].type & 3],
+           (int)(7 - strlen(type_names[caches[i].type & 3])), "");
+    print_size(caches[i].size);
+    if (caches[i].ways == 0)
+      printf(", fully associative");
+    else if (caches[i].ways < 0)
+      printf(", unknown associativity");
+    else
+      printf(", %d-way", caches[i].ways);
+    printf(", %d byte lines", caches[i].line_size);
+    if (caches[i].sets > 0)
+      printf(", %d sets", caches[i].sets);
+    if (caches[i].inclusive)
+      printf(", inclusive");
+    if (caches[i].shared > 0)
+      printf(", shared by up to %d CPUs", caches[i].shared);
+    printf("\n");
+  }
 }
 
-void cpuidcx(int info[4], int InfoType, int cx) {
-    __cpuid_count(InfoType, cx, info[0], info[1], info[2], info[3]);
+
+void print_cpuset(const int *cpus, int n)
+{
+  char    buf[8 * MAX_CPUS];
+  _writer w;
+
+  writer_init(&w, buf, sizeof(buf));
+  writer_cpuset(&w, cpus, n);
+  fwrite(buf, 1, w.len, stdout);
 }
 
-#endif
-
-
-char cpu_id_str[13];
-char cpu_brand[49];
-int cpuid_level;
-int cpuid_ext_level;
-
-
-typedef struct {
-  int id;
-  char *vendor;
-} _vendor_strings;
-
-
-#define CPU_UNKNOWN   0
-#define CPU_Intel     1
-#define CPU_AMD       2
-#define CPU_Centauer  3
-#define CPU_Cyrix     4
-#define CPU_Hygon     5
-#define CPU_Transmeta 6
-#define CPU_NSC       7
-#define CPU_NexGen    8
-#define CPU_Rise      9
-#define CPU_SiS       10
-#define CPU_UMC       11
-#define CPU_VIA       12
-#define CPU_Vortex    13
-
-
-/* CPU feature flags */
-
-/* EAX=1: Processor Info and Feature Bits */
-int HW_FPU = 0;
-int HW_VME = 0;
-int HW_DE = 0;
-int HW_PSE = 0;
-int HW_TSC = 0;
-int HW_MSR = 0;
-int HW_PAE = 0;
-int HW_MCE = 0;
-int HW_CX8 = 0;
-int HW_APIC = 0;
-
-int HW_SEP = 0;
-int HW_MTRR = 0;
-int HW_PGE = 0;
-int HW_MCA = 0;
-int HW_CMOV = 0;
-int HW_PAT = 0;
-int HW_PSE36 = 0;
-int HW_PSN = 0;
-int HW_CLFLUSH = 0;
-
-int HW_DS = 0;
-int HW_ACPI = 0;
-int HW_MMX = 0;
-int HW_FXSR = 0;
-int HW_SSE = 0;
-int HW_SSE2 = 0;
-int HW_SS = 0;
-int HW_HTT = 0;
-int HW_TM = 0;
-int HW_IA64 = 0;
-int HW_PBE = 0;
-
-int HW_SSE3 = 0;
-int HW_PCLMUL = 0;
-int HW_DTES64 = 0;
-int HW_MONITOR = 0;
-#define HW_MWAIT HW_MONITOR
-int HW_DS_CPL = 0;
-int HW_VMX = 0;
-int HW_SMX = 0;
-int HW_EST = 0;
-int HW_TM2 = 0;
-int HW_SSSE3 = 0;
-int HW_CNXT_ID = 0;
-int HW_SDBG = 0;
-int HW_FMA = 0;
-int HW_CX16 = 0;
-int HW_XTPR = 0;
-int HW_PDCM = 0;
-int HW_PCID = 0;
-int HW_DCA = 0;
-int HW_SSE41 = 0;
-int HW_SSE42 = 0;
-int HW_X2APIC = 0;
-int HW_MOVBE = 0;
-int HW_POPCNT = 0;
-int HW_TSC_DEADLINE = 0;
-int HW_AES = 0;
-int HW_XSAVE = 0;
-int HW_OSXSAVE = 0;
-int HW_AVX = 0;
-int HW_F16C = 0;
-int HW_RDRND = 0;
-int HW_HYPERVISOR = 0;
-
-
-/* EAX=80000001h: Extended Processor Info and Feature Bits */
-
-int HW_SYSCALL = 0;
-int HW_MP = 0;
-int HW_NX = 0;
-int HW_MMEXT = 0;
-int HW_FXSR_OPT = 0;
-int HW_PDPE1GB = 0;
-int HW_RDTSCP  = 0;
-int HW_LM = 0;
-int HW_3DNOWEXT = 0;
-int HW_3DNOW = 0;
-
-
-int HW_LAHF_LM = 0;
-int HW_CMP_LEGACY = 0;
-int HW_SVM = 0;
-int HW_EXTAPIC = 0;
-int HW_CR8_LEGACY = 0;
-int HW_ABM = 0;
-int HW_SSE4A = 0;
-int HW_MISALIGNSSE = 0;
-int HW_3DNOWPREFETCH = 0;
-int HW_OSVW = 0;
-int HW_IBS = 0;
-int HW_XOP = 0;
-int HW_SKINIT = 0;
-int HW_WDT = 0;
-int HW_LWP = 0;
-int HW_FMA4 = 0;
-int HW_TCE = 0;
-int HW_NODEID_MSR = 0;
-int HW_TBM = 0;
-int HW_TOPOEXT = 0;
-int HW_PERFCTR_CORE = 0;
-int HW_PERFCTR_NB = 0;
-int HW_DBX = 0;
-int HW_PERFTSC = 0;
-int HW_PCX_L2I = 0;
-int HW_MWAITX = 0;
-#define HW_MWAITT HW_WAITX
-
-
-/* extended feature flags EAX=7 */
-
-int HW_FSGSBASE = 0;
-int HW_SGX = 0;
-int HW_BMI = 0;
-int HW_HLE = 0;
-int HW_AVX2 = 0;
-int HW_SMEP = 0;
-int HW_BMI2 = 0;
-int HW_ERMS = 0;
-int HW_INVPCID = 0;
-int HW_RTM = 0;
-int HW_PQM = 0;
-int HW_MPX = 0;
-int HW_PQE = 0;
-int HW_AVX512F = 0;
-int HW_AVX512DQ = 0;
-int HW_RDSEED = 0;
-int HW_ADX = 0;
-#define HW_ADCX HW_ADX
-int HW_SMAP = 0;
-int HW_AVX512IFMA = 0;
-int HW_PCOMMIT = 0;
-int HW_CLFLUSHOPT = 0;
-int HW_CLWB = 0;
-int HW_INTEL_PT = 0;
-int HW_AVX512PF = 0;
-int HW_AVX512ER = 0;
-int HW_AVX512CD = 0;
-int HW_SHA = 0;
-int HW_AVX512BW = 0;
-int HW_AVX512VL = 0;
-
-int HW_PREFETCHWT1 = 0;
-int HW_AVX512VBMI = 0;
-int HW_UMIP = 0;
-int HW_PKU = 0;
-int HW_OSPKE = 0;
-int HW_AVX512VBMI2 = 0;
-int HW_GFNI = 0;
-#define HW_GFNI_SSE HW_GFNI
-int HW_VAES = 0;
-int HW_VPCLMULQDQ = 0;
-int HW_AVX512VNNI = 0;
-int HW_AVX512BITALG = 0;
-int HW_AVX512VPOPCNTDQ = 0;
-int HW_RDPID = 0;
-int HW_SGX_LC = 0;
-
-int HW_AVX5124VNNIW = 0;
-int HW_AVX5124FMAPS = 0;
-int HW_PCONFIG = 0;
-
-/*  Misc. */
-int HW_x64 = 0;
-
-
-int HW_PREFETCHW = 0;
-
-
-/* Processor Extended State Enumeration Main Leaf (EAX = 0DH, ECX = 0) */
-int HW_XSAVEC = 0;
-int HW_XSAVES = 0;
-int HW_XSAVEOPT = 0;
-int HW_XGETBV = 0;
-
-
-/* Intel Processor Trace Enumeration Main Leaf (EAX = 14H, ECX = 0) */
-
-int HW_PTWRITE;
-
-
-
-/* AMD-defined CPU features, CPUID level 0x80000008 (EBX) */
-int HW_CLZERO = 0;
-
-
-
-
-/* Intel CPUs */
-
-typedef struct {
-  int id;
-  char *arch;
-} _cpu_arch;
-
-
-#define cpu_x86_64            0
-#define intel_core2           100
-#define intel_nehalem         101
-#define intel_westmere        102
-#define intel_sandybridge     103
-#define intel_ivybridge       104
-#define intel_haswell         105
-#define intel_broadwell       106
-#define intel_skylake         107
-#define intel_bonnell         108
-#define intel_silvermont      109
-#define intel_goldmont        110
-#define intel_goldmont_plus   111
-#define intel_tremont         112
-#define intel_knl             113
-#define intel_knm             114
-#define intel_skylake_avx512  115
-#define intel_cannonlake      116
-#define intel_icelake_client  117
-#define intel_icelake_server  118
-#define intel_cascadelake     119
-
-#define amd_athlon64          200
-#define amd_athlon64_sse3     201
-#define amd_amdfam10          202
-#define amd_bdver1            203
-#define amd_bdver2            204
-#define amd_bdver3            205
-#define amd_bdver4            206
-#define amd_znver1            207
-#define amd_znver2            208
-#define amd_btver1            209
-#define amd_btver2            210
-
-
-_cpu_arch cpu_archs[] = {{intel_core2, "core2"},
-                         {intel_nehalem, "nehalem"},
-                         {intel_westmere, "westmere"},
-                         {intel_sandybridge, "sandybridge"},
-                         {intel_ivybridge, "ivybridge"},
-                         {intel_haswell, "haswell"},
-                         {intel_broadwell, "broadwell"},
-                         {intel_skylake, "skylake"},
-                         {intel_bonnell, "bonnell"},
-                         {intel_silvermont, "silvermont"},
-                         {intel_goldmont, "goldmont"},
-                         {intel_goldmont_plus, "goldmont-plus"},
-                         {intel_tremont, "tremont"},
-                         {intel_knl, "knl"},
-                         {intel_knm, "knm"},
-                         {intel_skylake_avx512, "skylake-avx512"},
-                         {intel_cannonlake, "cannonlake"},
-                         {intel_icelake_client, "icelake-client"},
-                         {intel_icelake_server, "icelake-server"},
-                         {intel_cascadelake, "cascadelake"},
-                         {amd_athlon64, "athlon64"},
-                         {amd_athlon64_sse3, "athlon64_sse3"},
-                         {amd_amdfam10, "amdfam10"},
-                         {amd_bdver1, "bdver1"},
-                         {amd_bdver2, "bdver2"},
-                         {amd_bdver3, "bdver3"},
-                         {amd_bdver4, "bdver4"},
-                         {amd_znver1, "znver1"},
-                         {amd_znver2, "znver2"},
-                         {amd_btver1, "btver1"},
-                         {amd_btver2, "btver1"},
-                         {cpu_x86_64, NULL}
-                       };
-
-
-int cpu_type;
-
-_vendor_strings vendor_string[14] = { { CPU_Intel, "GenuineIntel"},
-                                     { CPU_AMD, "AuthenticAMD"},
-                                     { CPU_Centauer, "CentaurHauls"},
-                                     { CPU_Cyrix, "CyrixInstead"},
-                                     { CPU_Hygon, "HygonGenuine"},
-                                     { CPU_Transmeta, "TransmetaCPU"},
-                                     { CPU_Transmeta, "TransmetaCPU"},
-                                     { CPU_NSC, "Geode by NSC"},
-                                     { CPU_NexGen, ""},
-                                     { CPU_Rise, ""},
-                                     { CPU_UMC, ""},
-                                     { CPU_VIA, ""},
-                                     { CPU_Vortex, ""},
-                                     { CPU_UNKNOWN, NULL }
-                                   };
-
-
-/* cpu_manufacturer_id
-
-the result is stored in that order, a, c, b corresponding to
-EBX, EDX, ECX!
+
+#define group_l3   0
+#define group_node 1
+#define group_type 2
+
+
+int group_id(const _cpu_topology *cpu, int group)
+{
+  switch (group)
+  {
+    case group_l3:
+      return cpu->l3_domain;
+    case group_node:
+      return cpu->node;
+    default:
+      return cpu->core_type;
+  }
+}
+
+
+/* group_cpus
+
+collects the valid CPUs of one L3 domain, NUMA node or core type,
+returns their number
 */
 
-void cpu_manufacturer_id(int a, int c, int b)
+int group_cpus(const _cpu_topology *cpus, int n, int group, int id,
+               int *list)
 {
-  cpu_id_str[12] = '\0';
-  cpu_id_str[0] = (char)(a >> 0) & 0xff;
-  cpu_id_str[1] = (char)(a >> 8) & 0xff;
-  cpu_id_str[2] = (char)(a >> 16) & 0xff;
-  cpu_id_str[3] = (char)(a >> 24) & 0xff;
-  cpu_id_str[4] = (char)(b >> 0) & 0xff;
-  cpu_id_str[5] = (char)(b >> 8) & 0xff;
-  cpu_id_str[6] = (char)(b >> 16) & 0xff;
-  cpu_id_str[7] = (char)(b >> 24) & 0xff;
-  cpu_id_str[8] = (char)(c >> 0) & 0xff;
-  cpu_id_str[9] = (char)(c >> 8) & 0xff;
-  cpu_id_str[10] = (char)(c >> 16) & 0xff;
-  cpu_id_str[11] = (char)(c >> 24) & 0xff;
+  int i, count = 0;
+
+  for (i = 0; i < n; ++i)
+    if (cpus[i].valid && (group_id(&cpus[i], group) == id))
+      list[count++] = cpus[i].cpu;
+
+  return count;
 }
 
 
-void set_cpu_type(void)
+const char *core_type_name(int core_type)
 {
-  int i = 0;
+  switch (core_type)
+  {
+    case core_type_core:
+      return "P";
+    case core_type_atom:
+      return "E";
+    default:
+      return "-";
+  }
+}
+
+
+/* max_group
+
+returns the highest L3 domain or NUMA node of the valid CPUs, -1 if
+there is none
+*/
 
-  while (vendor_string[i].id != CPU_UNKNOWN)
+int max_group(const _cpu_topology *cpus, int n, int group)
+{
+  int i, id, max = -1;
+
+  for (i = 0; i < n; ++i)
   {
-    if (strcmp(cpu_id_str, vendor_string[i].vendor) == 0)
-    {
-      cpu_type = vendor_string[i].id;
-      return;
-    }
-    ++i;
+    id = group_id(&cpus[i], group);
+    if (cpus[i].valid && (id > max))
+      max = id;
   }
 
-  cpu_type = CPU_UNKNOWN;
+  return max;
 }
 
 
-void get_cpu_flags(void)
+/* first_node
+
+returns the NUMA node of the first CPU of an L3 domain
+*/
+
+int first_node(const _cpu_topology *cpus, int n, int l3_domain)
 {
-  int info[4];
-  int nIds;
-  unsigned nExIds;
+  int i;
 
-  cpuid(info, 0);
-  nIds = info[0];   /* the maximum leaf for question with cpuid */
-  cpuid_level = nIds;
+  for (i = 0; i < n; ++i)
+    if (cpus[i].valid && (cpus[i].l3_domain == l3_domain))
+      return cpus[i].node;
 
-  /* read the vendor string */
-  cpu_manufacturer_id(info[1], info[2], info[3]);
-  set_cpu_type();
+  return -1;
+}
 
-  cpuid(info, 0x80000000);
-  nExIds = info[0];  /* the maximum leaf for extended couid questions*/
-  cpuid_ext_level = nExIds;
 
-  /* Detect Features */
-  if (nIds >= 0x00000001)
+void report_topology(void)
+{
+  _cpu_topology         *cpus;
+  _cpu_topology_summary  sum;
+  int                   *core_cpus;
+  int                    n, i, id, count;
+
+  cpus = (_cpu_topology *)malloc(MAX_CPUS * sizeof(_cpu_topology));
+  core_cpus = (int *)malloc(MAX_CPUS * sizeof(int));
+  if ((cpus == NULL) || (core_cpus == NULL)
+      || ((n = dcpu_topology(cpus, MAX_CPUS)) < 0))
   {
-    cpuid(info, 0x00000001);
-    HW_FPU     = (info[3] & ((int)1 << 0)) != 0;
-	  HW_VME     = (info[3] & ((int)1 << 1)) != 0;
-	  HW_DE      = (info[3] & ((int)1 << 2)) != 0;
-	  HW_PSE     = (info[3] & ((int)1 << 3)) != 0;
-	  HW_TSC     = (info[3] & ((int)1 << 4)) != 0;
-	  HW_MSR     = (info[3] & ((int)1 << 5)) != 0;
-	  HW_PAE     = (info[3] & ((int)1 << 6)) != 0;
-	  HW_MCE     = (info[3] & ((int)1 << 7)) != 0;
-	  HW_CX8     = (info[3] & ((int)1 << 8)) != 0;
-	  HW_APIC    = (info[3] & ((int)1 << 9)) != 0;
-
-	  HW_SEP     = (info[3] & ((int)1 << 11)) != 0;
-    HW_MTRR    = (info[3] & ((int)1 << 12)) != 0;
-    HW_PGE     = (info[3] & ((int)1 << 13)) != 0;
-    HW_MCA     = (info[3] & ((int)1 << 14)) != 0;
-    HW_CMOV    = (info[3] & ((int)1 << 15)) != 0;
-    HW_PAT     = (info[3] & ((int)1 << 16)) != 0;
-    HW_PSE36   = (info[3] & ((int)1 << 17)) != 0;
-    HW_PSN     = (info[3] & ((int)1 << 18)) != 0;
-    HW_CLFLUSH = (info[3] & ((int)1 << 19)) != 0;
-
-	  HW_DS      = (info[3] & ((int)1 << 21)) != 0;
-    HW_ACPI    = (info[3] & ((int)1 << 22)) != 0;
-    HW_MMX     = (info[3] & ((int)1 << 23)) != 0;
-    HW_FXSR    = (info[3] & ((int)1 << 24)) != 0;
-    HW_SSE     = (info[3] & ((int)1 << 25)) != 0;
-    HW_SSE2    = (info[3] & ((int)1 << 26)) != 0;
-    HW_SS      = (info[3] & ((int)1 << 27)) != 0;
-    HW_HTT     = (info[3] & ((int)1 << 28)) != 0;
-    HW_TM      = (info[3] & ((int)1 << 29)) != 0;
-    HW_IA64    = (info[3] & ((int)1 << 30)) != 0;
-    HW_PBE     = (info[3] & ((int)1 << 31)) != 0;
-
-
-    HW_SSE3    = (info[2] & ((int)1 <<  0)) != 0;
-    HW_PCLMUL  = (info[2] & ((int)1 <<  1)) != 0;
-    HW_DTES64  = (info[2] & ((int)1 <<  2)) != 0;
-    HW_MONITOR = (info[2] & ((int)1 <<  3)) != 0;
-    HW_DS_CPL  = (info[2] & ((int)1 <<  4)) != 0;
-    HW_VMX     = (info[2] & ((int)1 <<  5)) != 0;
-    HW_SMX     = (info[2] & ((int)1 <<  6)) != 0;
-    HW_EST     = (info[2] & ((int)1 <<  7)) != 0;
-    HW_TM2     = (info[2] & ((int)1 <<  8)) != 0;
-    HW_SSSE3   = (info[2] & ((int)1 <<  9)) != 0;
-    HW_CNXT_ID = (info[2] & ((int)1 << 10)) != 0;
-    HW_SDBG    = (info[2] & ((int)1 << 11)) != 0;
-    HW_FMA     = (info[2] & ((int)1 << 12)) != 0;
-    HW_CX16    = (info[2] & ((int)1 << 13)) != 0;
-    HW_XTPR    = (info[2] & ((int)1 << 14)) != 0;
-    HW_PDCM    = (info[2] & ((int)1 << 15)) != 0;
-    HW_PCID    = (info[2] & ((int)1 << 17)) != 0;
-    HW_DCA     = (info[2] & ((int)1 << 18)) != 0;
-    HW_SSE41   = (info[2] & ((int)1 << 19)) != 0;
-    HW_SSE42   = (info[2] & ((int)1 << 20)) != 0;
-    HW_X2APIC  = (info[2] & ((int)1 << 21)) != 0;
-    HW_MOVBE   = (info[2] & ((int)1 << 22)) != 0;
-    HW_POPCNT  = (info[2] & ((int)1 << 23)) != 0;
-    HW_TSC_DEADLINE = (info[2] & ((int)1 << 24)) != 0;
-    HW_AES     = (info[2] & ((int)1 << 25)) != 0;
-    HW_XSAVE   = (info[2] & ((int)1 << 26)) != 0;
-    HW_OSXSAVE = (info[2] & ((int)1 << 27)) != 0;
-    HW_AVX     = (info[2] & ((int)1 << 28)) != 0;
-    HW_F16C    = (info[2] & ((int)1 << 29)) != 0;
-    HW_RDRND   = (info[2] & ((int)1 << 30)) != 0;
-    HW_HYPERVISOR = (info[2] & ((int)1 << 31)) != 0;
+    fprintf(stderr, "Cannot read the CPU topology!\n");
+    free(cpus);
+    free(core_cpus);
+    return;
   }
 
-  if (nIds >= 0x00000007)
+  printf("CPU   APIC  package  die  module  core  thread   l3  node  type\n");
+  for (i = 0; i < n; ++i)
   {
-    cpuid(info, 0x00000007);
-    HW_FSGSBASE    = (info[1] & ((int)1 <<  0)) != 0;
-    HW_SGX         = (info[1] & ((int)1 <<  2)) != 0;
-    HW_BMI         = (info[1] & ((int)1 <<  3)) != 0;
-    HW_HLE         = (info[1] & ((int)1 <<  4)) != 0;
-    HW_AVX2        = (info[1] & ((int)1 <<  5)) != 0;
-    HW_SMEP        = (info[1] & ((int)1 <<  7)) != 0;
-    HW_BMI2        = (info[1] & ((int)1 <<  8)) != 0;
-    HW_ERMS        = (info[1] & ((int)1 <<  9)) != 0;
-    HW_INVPCID     = (info[1] & ((int)1 << 10)) != 0;
-    HW_RTM         = (info[1] & ((int)1 << 11)) != 0;
-    HW_PQM         = (info[1] & ((int)1 << 12)) != 0;
-    HW_MPX         = (info[1] & ((int)1 << 14)) != 0;
-    HW_PQE         = (info[1] & ((int)1 << 15)) != 0;
-    HW_AVX512F     = (info[1] & ((int)1 << 16)) != 0;
-    HW_AVX512DQ    = (info[1] & ((int)1 << 17)) != 0;
-    HW_RDSEED      = (info[1] & ((int)1 << 18)) != 0;
-    HW_ADX         = (info[1] & ((int)1 << 19)) != 0;
-    HW_SMAP        = (info[1] & ((int)1 << 20)) != 0;
-    HW_AVX512IFMA  = (info[1] & ((int)1 << 21)) != 0;
-    HW_PCOMMIT     = (info[1] & ((int)1 << 22)) != 0;
-    HW_CLFLUSHOPT  = (info[1] & ((int)1 << 23)) != 0;
-    HW_CLWB        = (info[1] & ((int)1 << 24)) != 0;
-    HW_INTEL_PT    = (info[1] & ((int)1 << 25)) != 0;
-    HW_AVX512PF    = (info[1] & ((int)1 << 26)) != 0;
-    HW_AVX512ER    = (info[1] & ((int)1 << 27)) != 0;
-    HW_AVX512CD    = (info[1] & ((int)1 << 28)) != 0;
-    HW_SHA         = (info[1] & ((int)1 << 29)) != 0;
-    HW_AVX512BW    = (info[1] & ((int)1 << 30)) != 0;
-    HW_AVX512VL    = (info[1] & ((int)1 << 31)) != 0;
-
-    HW_PREFETCHWT1 = (info[2] & ((int)1 <<  0)) != 0;
-    HW_AVX512VBMI  = (info[2] & ((int)1 <<  1)) != 0;
-    HW_UMIP        = (info[2] & ((int)1 <<  2)) != 0;
-    HW_PKU         = (info[2] & ((int)1 <<  3)) != 0;
-    HW_OSPKE       = (info[2] & ((int)1 <<  4)) != 0;
-    HW_AVX512VBMI2 = (info[2] & ((int)1 <<  6)) != 0;
-    HW_GFNI        = (info[2] & ((int)1 <<  8)) != 0;
-    HW_VAES        = (info[2] & ((int)1 <<  9)) != 0;
-    HW_VPCLMULQDQ  = (info[2] & ((int)1 << 10)) != 0;
-    HW_AVX512VNNI  = (info[2] & ((int)1 << 11)) != 0;
-    HW_AVX512BITALG = (info[2] & ((int)1 << 12)) != 0;
-    HW_AVX512VPOPCNTDQ = (info[2] & ((int)1 << 14)) != 0;
-    HW_RDPID       = (info[2] & ((int)1 << 22)) != 0;
-    HW_SGX_LC      = (info[2] & ((int)1 << 30)) != 0;
-
-    HW_AVX5124VNNIW = (info[3] & ((int)1 <<  2)) != 0;
-    HW_AVX5124FMAPS = (info[3] & ((int)1 <<  3)) != 0;
-    HW_PCONFIG      = (info[3] & ((int)1 << 18)) != 0;
+    if (!cpus[i].valid)
+    {
+      printf("%3d   (not probed)\n", cpus[i].cpu);
+      continue;
+    }
+    printf("%3d  %5u  %7d  %3d  %6d  %4d  %6d  %3d  %4d  %4s\n", cpus[i].cpu,
+           cpus[i].apic_id, cpus[i].package_id, cpus[i].die_id,
+           cpus[i].module_id, cpus[i].core_id, cpus[i].smt_id,
+           cpus[i].l3_domain, cpus[i].node, core_type_name(cpus[i].core_type));
   }
 
-  if (nIds >= 0x0000000d)
+  dcpu_topology_summary(cpus, n, &sum, core_cpus);
+  printf("Packages       : %d\n", sum.packages);
+  printf("Cores          : %d\n", sum.cores);
+  printf("Threads        : %d\n", sum.threads);
+  printf("Core CPUs      : ");
+  print_cpuset(core_cpus, sum.cores);
+  printf("\n");
+
+  /* core_cpus is reused for the CPU lists of the groups */
+  printf("L3 domains     : %d\n", sum.l3_domains);
+  for (id = 0; id <= max_group(cpus, n, group_l3); ++id)
   {
-    /* EAX=0dh ECX=1 */
-    cpuidcx(info, 0x0000000d, 1);
+    printf("L3 domain %-5d: ", id);
+    print_cpuset(core_cpus, group_cpus(cpus, n, group_l3, id, core_cpus));
+    if (first_node(cpus, n, id) >= 0)
+      printf(" (node %d)", first_node(cpus, n, id));
+    printf("\n");
+  }
+  printf("NUMA nodes     : %d\n", sum.nodes);
+  for (id = 0; id <= max_group(cpus, n, group_node); ++id)
+  {
+    count = group_cpus(cpus, n, group_node, id, core_cpus);
+    if (count == 0)
+      continue;
+    printf("Node %-10d: ", id);
+    print_cpuset(core_cpus, count);
+    printf("\n");
+  }
+  count = group_cpus(cpus, n, group_type, core_type_core, core_cpus);
+  if (count > 0)
+  {
+    printf("P-cores        : ");
+    print_cpuset(core_cpus, count);
+    printf("\n");
+  }
+  count = group_cpus(cpus, n, group_type, core_type_atom, core_cpus);
+  if (count > 0)
+  {
+    printf("E-cores        : ");
+    print_cpuset(core_cpus, count);
+    printf("\n");
+  }
+
+  free(cpus);
+  free(core_cpus);
+}
+
 
-    HW_XSAVEOPT = (info[0] & ((int)1 << 0)) != 0;
-    HW_XSAVEC   = (info[0] & ((int)1 << 1)) != 0;
-    HW_XGETBV   = ((info[0] & ((int)1 << 2)) != 0) && (info[2] == 1);
-    HW_XSAVES   = (info[0] & ((int)1 << 3)) != 0;
+/* structured output
 
+   the JSON and the key=value report are written with one append-only
+   writer into a fixed buffer and flushed with a single write()
+*/
+
+#define OUTPUT_SIZE (256 * 1024)
+
+static char output_buffer[OUTPUT_SIZE];
+
+
+const char *cache_type_name(int type)
+{
+  switch(type)
+  {
+    case cache_data:
+      return "data";
+    case cache_instruction:
+      return "instruction";
+    default:
+      return "unified";
   }
+}
 
 
-  if (nIds >= 0x00000014)
+const char *tsc_source_name(int source)
+{
+  switch (source)
   {
-    /* EAX=14h ECX=0 */
-    cpuid(info, 0x00000014);
+    case tsc_source_cpuid:
+      return "cpuid";
+    case tsc_source_hypervisor:
+      return "hypervisor";
+    case tsc_source_calibrated:
+      return "calibrated";
+    default:
+      return "unknown";
+  }
+}
+
+
+void json_key(_writer *w, const char *key)
+{
+  writer_json_string(w, key);
+  writer_str(w, ": ");
+}
+
+
+/* the feature lists of the reports */
+#define list_usable          0
+#define list_os_disabled     1
+#define list_masked          2
+#define list_kernel_disabled 3
+#define list_kernel_only     4
+
+
 
-    HW_PTWRITE = (info[1] & ((int)1 << 4)) != 0;
+int feature_listed(int feature, int list)
+{
+  switch (list)
+  {
+    case list_os_disabled:
+      return dcpu_os_disabled(feature)
+             && !feature_listed(feature, list_kernel_disabled);
+    case list_masked:
+      return dcpu_masked(feature);
+    case list_kernel_disabled:
+      return effective_used
+             && featureset_has(&effective.kernel_disabled, feature);
+    case list_kernel_only:
+      return effective_used && effective.cpuid_usable
+             && featureset_has(&effective.kernel_only, feature);
+    default:
+      return dcpu_has(feature);
   }
+}
 
 
+void json_features(_writer *w, const char *key, int list)
+{
+  int i, n = 0;
 
-  if (nExIds >= 0x80000001)
+  writer_str(w, "  ");
+  json_key(w, key);
+  writer_char(w, '[');
+  for (i = 0; i < HW_NUM_FEATURES; ++i)
   {
-    cpuid(info, 0x80000001);
-
-    /*
-    HW_FPU       = (info[3] & ((int)1 <<  0)) != 0;
-    HW_VME       = (info[3] & ((int)1 <<  1)) != 0;
-    HW_DE        = (info[3] & ((int)1 <<  2)) != 0;
-    HW_PSE       = (info[3] & ((int)1 <<  3)) != 0;
-    HW_TSC       = (info[3] & ((int)1 <<  4)) != 0;
-    HW_MSR       = (info[3] & ((int)1 <<  5)) != 0;
-    HW_PAE       = (info[3] & ((int)1 <<  6)) != 0;
-    HW_MCE       = (info[3] & ((int)1 <<  7)) != 0;
-    HW_CX8       = (info[3] & ((int)1 <<  8)) != 0;
-    HW_APIC      = (info[3] & ((int)1 <<  9)) != 0; */
-    HW_SYSCALL   = (info[3] & ((int)1 << 11)) != 0;
-    /*
-    HW_MTRR      = (info[3] & ((int)1 << 12)) != 0;
-    HW_PGE	 = (info[3] & ((int)1 << 13)) != 0;
-    HW_MCA 	 = (info[3] & ((int)1 << 14)) != 0;
-    HW_CMOV      = (info[3] & ((int)1 << 15)) != 0;
-    HW_PAT       = (info[3] & ((int)1 << 16)) != 0;
-    HW_PSE36     = (info[3] & ((int)1 << 17)) != 0; */
-    HW_MP        = (info[3] & ((int)1 << 19)) != 0;
-    HW_NX        = (info[3] & ((int)1 << 20)) != 0;
-    HW_MMEXT     = (info[3] & ((int)1 << 22)) != 0;
-    /*
-    HW_MMX       = (info[3] & ((int)1 << 23)) != 0;
-    HW_FXSR      = (info[3] & ((int)1 << 24)) != 0; */
-    HW_FXSR_OPT  = (info[3] & ((int)1 << 25)) != 0;
-    HW_PDPE1GB   = (info[3] & ((int)1 << 26)) != 0;
-    HW_RDTSCP    = (info[3] & ((int)1 << 27)) != 0;
-    HW_LM        = (info[3] & ((int)1 << 29)) != 0;
-    HW_3DNOWEXT  = (info[3] & ((int)1 << 30)) != 0;
-    HW_3DNOW     = (info[3] & ((int)1 << 31)) != 0;
-
-    HW_LAHF_LM   = (info[2] & ((int)1 <<  0)) != 0;
-    HW_CMP_LEGACY = (info[2] & ((int)1 <<  1)) != 0;
-    HW_SVM       = (info[2] & ((int)1 <<  2)) != 0;
-    HW_EXTAPIC   = (info[2] & ((int)1 <<  3)) != 0;
-    HW_CR8_LEGACY = (info[2] & ((int)1 <<  4)) != 0;
-    HW_ABM       = (info[2] & ((int)1 <<  5)) != 0;
-    HW_SSE4A     = (info[2] & ((int)1 <<  6)) != 0;
-    HW_MISALIGNSSE = (info[2] & ((int)1 <<  7)) != 0;
-    HW_3DNOWPREFETCH = (info[2] & ((int)1 <<  8)) != 0;
-    HW_OSVW      = (info[2] & ((int)1 <<  9)) != 0;
-    HW_IBS       = (info[2] & ((int)1 << 10)) != 0;
-    HW_XOP       = (info[2] & ((int)1 << 11)) != 0;
-    HW_SKINIT    = (info[2] & ((int)1 << 12)) != 0;
-    HW_WDT       = (info[2] & ((int)1 << 13)) != 0;
-    HW_LWP       = (info[2] & ((int)1 << 15)) != 0;
-    HW_FMA4      = (info[2] & ((int)1 << 16)) != 0;
-    HW_TCE       = (info[2] & ((int)1 << 17)) != 0;
-    HW_NODEID_MSR = (info[2] & ((int)1 << 19)) != 0;
-    HW_TBM       = (info[2] & ((int)1 << 21)) != 0;
-    HW_TOPOEXT   = (info[2] & ((int)1 << 22)) != 0;
-    HW_PERFCTR_CORE = (info[2] & ((int)1 << 23)) != 0;
-    HW_PERFCTR_NB = (info[2] & ((int)1 << 24)) != 0;
-    HW_DBX       = (info[2] & ((int)1 << 26)) != 0;
-    HW_PERFTSC   = (info[2] & ((int)1 << 27)) != 0;
-    HW_PCX_L2I   = (info[2] & ((int)1 << 28)) != 0;
-    HW_MWAITX    = (info[2] & ((int)1 << 29)) != 0;
-
-
-    /* copy for some backup usage */
-    HW_x64       = HW_LM;
-    HW_PREFETCHW = HW_3DNOWPREFETCH;
+    if (!feature_listed(i, list))
+      continue;
+    if (n++ > 0)
+      writer_str(w, ", ");
+    writer_json_string(w, dcpu_feature_name(i));
   }
+  writer_str(w, "],\n");
+}
 
-  if (nExIds >= 0x80000004)
+
+void json_caches(_writer *w)
+{
+  const _cpu_cache *caches;
+  int               n, i;
+
+  caches = dcpu_caches(&n);
+
+  writer_str(w, "  ");
+  json_key(w, "caches");
+  writer_char(w, '[');
+  for (i = 0; i < n; ++i)
   {
-    cpu_brand[48] = '\0';
-    cpuid(info, 0x80000002);
-    cpu_brand[0] = (char)(info[0] >> 0) & 0xff;
-    cpu_brand[1] = (char)(info[0] >> 8) & 0xff;
-    cpu_brand[2] = (char)(info[0] >> 16) & 0xff;
-    cpu_brand[3] = (char)(info[0] >> 24) & 0xff;
-    cpu_brand[4] = (char)(info[1] >> 0) & 0xff;
-    cpu_brand[5] = (char)(info[1] >> 8) & 0xff;
-    cpu_brand[6] = (char)(info[1] >> 16) & 0xff;
-    cpu_brand[7] = (char)(info[1] >> 24) & 0xff;
-    cpu_brand[8] = (char)(info[2] >> 0) & 0xff;
-    cpu_brand[9] = (char)(info[2] >> 8) & 0xff;
-    cpu_brand[10] = (char)(info[2] >> 16) & 0xff;
-    cpu_brand[11] = (char)(info[2] >> 24) & 0xff;
-    cpu_brand[12] = (char)(info[3] >> 0) & 0xff;
-    cpu_brand[13] = (char)(info[3] >> 8) & 0xff;
-    cpu_brand[14] = (char)(info[3] >> 16) & 0xff;
-    cpu_brand[15] = (char)(info[3] >> 24) & 0xff;
-    cpuid(info, 0x80000003);
-    cpu_brand[16] = (char)(info[0] >> 0) & 0xff;
-    cpu_brand[17] = (char)(info[0] >> 8) & 0xff;
-    cpu_brand[18] = (char)(info[0] >> 16) & 0xff;
-    cpu_brand[19] = (char)(info[0] >> 24) & 0xff;
-    cpu_brand[20] = (char)(info[1] >> 0) & 0xff;
-    cpu_brand[21] = (char)(info[1] >> 8) & 0xff;
-    cpu_brand[22] = (char)(info[1] >> 16) & 0xff;
-    cpu_brand[23] = (char)(info[1] >> 24) & 0xff;
-    cpu_brand[24] = (char)(info[2] >> 0) & 0xff;
-    cpu_brand[25] = (char)(info[2] >> 8) & 0xff;
-    cpu_brand[26] = (char)(info[2] >> 16) & 0xff;
-    cpu_brand[27] = (char)(info[2] >> 24) & 0xff;
-    cpu_brand[28] = (char)(info[3] >> 0) & 0xff;
-    cpu_brand[29] = (char)(info[3] >> 8) & 0xff;
-    cpu_brand[30] = (char)(info[3] >> 16) & 0xff;
-    cpu_brand[31] = (char)(info[3] >> 24) & 0xff;
-    cpuid(info, 0x80000004);
-    cpu_brand[32] = (char)(info[0] >> 0) & 0xff;
-    cpu_brand[33] = (char)(info[0] >> 8) & 0xff;
-    cpu_brand[34] = (char)(info[0] >> 16) & 0xff;
-    cpu_brand[35] = (char)(info[0] >> 24) & 0xff;
-    cpu_brand[36] = (char)(info[1] >> 0) & 0xff;
-    cpu_brand[37] = (char)(info[1] >> 8) & 0xff;
-    cpu_brand[38] = (char)(info[1] >> 16) & 0xff;
-    cpu_brand[39] = (char)(info[1] >> 24) & 0xff;
-    cpu_brand[40] = (char)(info[2] >> 0) & 0xff;
-    cpu_brand[41] = (char)(info[2] >> 8) & 0xff;
-    cpu_brand[42] = (char)(info[2] >> 16) & 0xff;
-    cpu_brand[43] = (char)(info[2] >> 24) & 0xff;
-    cpu_brand[44] = (char)(info[3] >> 0) & 0xff;
-    cpu_brand[45] = (char)(info[3] >> 8) & 0xff;
-    cpu_brand[46] = (char)(info[3] >> 16) & 0xff;
-    cpu_brand[47] = (char)(info[3] >> 24) & 0xff;
+    writer_str(w, (i > 0) ? ",\n    {" : "\n    {");
+    json_key(w, "level");
+    writer_int(w, caches[i].level);
+    writer_str(w, ", ");
+    json_key(w, "type");
+    writer_json_string(w, cache_type_name(caches[i].type));
+    writer_str(w, ", ");
+    json_key(w, "size");
+    writer_uint(w, caches[i].size);
+    writer_str(w, ", ");
+    json_key(w, "ways");
+    writer_int(w, caches[i].ways);
+    writer_str(w, ", ");
+    json_key(w, "line_size");
+    writer_int(w, caches[i].line_size);
+    writer_str(w, ", ");
+    json_key(w, "sets");
+    writer_int(w, caches[i].sets);
+    writer_str(w, ", ");
+    json_key(w, "inclusive");
+    writer_str(w, caches[i].inclusive ? "true" : "false");
+    writer_str(w, ", ");
+    json_key(w, "shared");
+    writer_int(w, caches[i].shared);
+    writer_char(w, '}');
+  }
+  writer_str(w, (n > 0) ? "\n  ],\n" : "],\n");
+}
+
+
+/* json_groups
+
+writes the L3 domains or the NUMA nodes with their CPU lists
+*/
+
+void json_groups(_writer *w, const _cpu_topology *cpus, int n, int group)
+{
+  int list[MAX_CPUS];
+  int id, count, first = 1;
+
+  json_key(w, (group == group_l3) ? "l3_domains" : "nodes");
+  writer_char(w, '[');
+  for (id = 0; id <= max_group(cpus, n, group); ++id)
+  {
+    count = group_cpus(cpus, n, group, id, list);
+    if (count == 0)
+      continue;
+    writer_str(w, first ? "\n      {" : ",\n      {");
+    first = 0;
+    json_key(w, (group == group_l3) ? "l3" : "node");
+    writer_int(w, id);
+    writer_str(w, ", ");
+    if (group == group_l3)
+    {
+      json_key(w, "node");
+      writer_int(w, first_node(cpus, n, id));
+      writer_str(w, ", ");
+    }
+    json_key(w, "cpus");
+    writer_char(w, '"');
+    writer_cpuset(w, list, count);
+    writer_str(w, "\"}");
   }
+  writer_str(w, first ? "],\n    " : "\n    ],\n    ");
+}
+
+
+void json_topology(_writer *w)
+{
+  _cpu_topology         *cpus;
+  _cpu_topology_summary  sum;
+  _cpu_limits            lim;
+  char                   quota[32];
+  int                    n, i, first = 1;
+
+  writer_str(w, "  ");
+  json_key(w, "topology");
 
-  if (nExIds >= 0x80000006)
+  cpus = (_cpu_topology *)malloc(MAX_CPUS * sizeof(_cpu_topology));
+  if ((cpus == NULL) || ((n = dcpu_topology(cpus, MAX_CPUS)) < 0))
   {
-    cpuid(info, 0x80000006);
+    writer_str(w, "null\n");
+    free(cpus);
+    return;
   }
 
-  if (nExIds >= 0x80000008)
+  dcpu_topology_summary(cpus, n, &sum, NULL);
+  writer_str(w, "{\n    ");
+  if (dcpu_limits(cpus, n, &lim) == 0)
   {
-    cpuid(info, 0x80000008);
-    HW_CLZERO    = (info[1] & ((int)1 <<  0)) != 0;
+    json_key(w, "affinity");
+    writer_int(w, lim.affinity);
+    writer_str(w, ", ");
+    json_key(w, "cpuset");
+    writer_int(w, lim.cpuset);
+    writer_str(w, ", ");
+    json_key(w, "quota");
+    snprintf(quota, sizeof(quota), "%.2f", lim.quota);
+    writer_str(w, quota);
+    writer_str(w, ", ");
+    json_key(w, "core_workers");
+    writer_int(w, lim.core_workers);
+    writer_str(w, ", ");
+    json_key(w, "thread_workers");
+    writer_int(w, lim.thread_workers);
+    writer_str(w, ",\n    ");
   }
+  json_key(w, "packages");
+  writer_int(w, sum.packages);
+  writer_str(w, ", ");
+  json_key(w, "dies");
+  writer_int(w, sum.dies);
+  writer_str(w, ", ");
+  json_key(w, "cores");
+  writer_int(w, sum.cores);
+  writer_str(w, ", ");
+  json_key(w, "threads");
+  writer_int(w, sum.threads);
+  writer_str(w, ",\n    ");
+  json_groups(w, cpus, n, group_l3);
+  json_groups(w, cpus, n, group_node);
+  json_key(w, "cpus");
+  writer_char(w, '[');
+  for (i = 0; i < n; ++i)
+  {
+    if (!cpus[i].valid)
+      continue;
+    writer_str(w, first ? "\n      {" : ",\n      {");
+    first = 0;
+    json_key(w, "cpu");
+    writer_int(w, cpus[i].cpu);
+    writer_str(w, ", ");
+    json_key(w, "apic_id");
+    writer_uint(w, cpus[i].apic_id);
+    writer_str(w, ", ");
+    json_key(w, "package");
+    writer_int(w, cpus[i].package_id);
+    writer_str(w, ", ");
+    json_key(w, "die");
+    writer_int(w, cpus[i].die_id);
+    writer_str(w, ", ");
+    json_key(w, "module");
+    writer_int(w, cpus[i].module_id);
+    writer_str(w, ", ");
+    json_key(w, "core");
+    writer_int(w, cpus[i].core_id);
+    writer_str(w, ", ");
+    json_key(w, "smt");
+    writer_int(w, cpus[i].smt_id);
+    writer_str(w, ", ");
+    json_key(w, "l3");
+    writer_int(w, cpus[i].l3_domain);
+    writer_str(w, ", ");
+    json_key(w, "node");
+    writer_int(w, cpus[i].node);
+    writer_str(w, ", ");
+    json_key(w, "core_type");
+    writer_json_string(w, core_type_name(cpus[i].core_type));
+    writer_char(w, '}');
+  }
+  writer_str(w, "\n    ]\n  }\n");
+
+  free(cpus);
 }
 
 
-char *get_arch_name(int arch)
+int report_json(void)
 {
-  int i = 0;
+  const _cpu_info *info = dcpu_info();
+  _cpu_tsc         tsc;
+  _writer          w;
+
+  writer_init(&w, output_buffer, sizeof(output_buffer));
+
+  writer_str(&w, "{\n  ");
+  json_key(&w, "vendor");
+  writer_json_string(&w, info->vendor);
+  writer_str(&w, ",\n  ");
+  json_key(&w, "brand");
+  writer_json_string(&w, info->brand);
+  writer_str(&w, ",\n  ");
+  json_key(&w, "cpuid_level");
+  writer_uint(&w, info->cpuid_level);
+  writer_str(&w, ",\n  ");
+  json_key(&w, "cpuid_ext_level");
+  writer_uint(&w, info->cpuid_ext_level);
+  writer_str(&w, ",\n  ");
+  json_key(&w, "signature");
+  writer_uint(&w, info->signature);
+  writer_str(&w, ",\n  ");
+  json_key(&w, "arch");
+  writer_json_string(&w, dcpu_arch());
+  writer_str(&w, ",\n  ");
+  json_key(&w, "tune");
+  writer_json_string(&w, dcpu_tune());
+  writer_str(&w, ",\n  ");
+  json_key(&w, "level");
+  writer_json_string(&w, dcpu_level());
+  writer_str(&w, ",\n  ");
+  json_key(&w, "xcr0");
+  writer_uint(&w, info->xcr0);
+  writer_str(&w, ",\n  ");
+  json_key(&w, "hypervisor");
+  if (dcpu_hypervisor() != NULL)
+    writer_json_string(&w, dcpu_hypervisor());
+  else
+    writer_str(&w, "null");
+  writer_str(&w, ",\n");
+
+  /* no calibration, the fleet agents run this on every boot */
+  dcpu_tsc_cpuid(&tsc);
+  writer_str(&w, "  ");
+  json_key(&w, "tsc");
+  writer_str(&w, "{ ");
+  json_key(&w, "invariant");
+  writer_str(&w, tsc.invariant ? "true" : "false");
+  writer_str(&w, ", ");
+  json_key(&w, "hz");
+  writer_uint(&w, tsc.tsc_hz);
+  writer_str(&w, ", ");
+  json_key(&w, "source");
+  writer_json_string(&w, tsc_source_name(tsc.source));
+  writer_str(&w, " },\n");
+
+  json_features(&w, "features", list_usable);
+  json_features(&w, "os_disabled", list_os_disabled);
+  json_features(&w, "masked", list_masked);
+  json_caches(&w);
+  json_topology(&w);
+
+  writer_str(&w, "}\n");
+
+  return (writer_flush(&w, STDOUT_FILENO) == 0) ? 0 : 1;
+}
 
-  while (cpu_archs[i].id != cpu_x86_64)
+
+void env_key(_writer *w, const char *key)
+{
+  writer_str(w, "DCPU_");
+  writer_str(w, key);
+  writer_char(w, '=');
+}
+
+
+void env_features(_writer *w, const char *key, int list)
+{
+  int i, n = 0;
+
+  env_key(w, key);
+  writer_char(w, '\'');
+  for (i = 0; i < HW_NUM_FEATURES; ++i)
   {
-    if (cpu_archs[i].id == arch)
-      return strdup(cpu_archs[i].arch);
-    ++i;
+    if (!feature_listed(i, list))
+      continue;
+    if (n++ > 0)
+      writer_char(w, ' ');
+    writer_str(w, dcpu_feature_name(i));
   }
+  writer_str(w, "'\n");
+}
+
+
+void env_cache_value(_writer *w, const _cpu_cache *cache, const char *name,
+                     long long value)
+{
+  static const char *type_names[] = { "", "D", "I", "" };
+  char               key[32];
+
+  snprintf(key, sizeof(key), "L%d%s_%s", cache->level,
+           type_names[cache->type & 3], name);
+  env_key(w, key);
+  writer_int(w, value);
+  writer_char(w, '\n');
+}
+
+
+/* env_groups
+
+writes the number of L3 domains or NUMA nodes and their CPU lists,
+separated by spaces in the order of the ids, e.g. '0-7 8-15'
+*/
 
-  return strdup("x86-64");
+void env_groups(_writer *w, const _cpu_topology *cpus, int n, int group,
+                int *list)
+{
+  int id, count, groups = 0;
+
+  for (id = 0; id <= max_group(cpus, n, group); ++id)
+    groups += (group_cpus(cpus, n, group, id, list) > 0);
+
+  env_key(w, (group == group_l3) ? "L3_DOMAINS" : "NODES");
+  writer_int(w, groups);
+  writer_char(w, '\n');
+  env_key(w, (group == group_l3) ? "L3_CPUS" : "NODE_CPUS");
+  writer_char(w, '\'');
+  for (id = 0, groups = 0; id <= max_group(cpus, n, group); ++id)
+  {
+    count = group_cpus(cpus, n, group, id, list);
+    if (count == 0)
+      continue;
+    if (groups++ > 0)
+      writer_char(w, ' ');
+    writer_cpuset(w, list, count);
+  }
+  writer_str(w, "'\n");
 }
 
 
-int get_gcc_arch_type_intel(void)
+void env_topology(_writer *w)
 {
-  if (HW_MMX && HW_SSE && HW_SSE2 && HW_SSE3 && HW_SSSE3)
+  _cpu_topology         *cpus;
+  _cpu_topology_summary  sum;
+  _cpu_limits            lim;
+  char                   quota[32];
+  int                   *core_cpus;
+  int                    n;
+
+  cpus = (_cpu_topology *)malloc(MAX_CPUS * sizeof(_cpu_topology));
+  core_cpus = (int *)malloc(MAX_CPUS * sizeof(int));
+  if ((cpus != NULL) && (core_cpus != NULL)
+      && ((n = dcpu_topology(cpus, MAX_CPUS)) >= 0))
   {
-    if (HW_SSE41 && HW_SSE42 && HW_POPCNT)
+    dcpu_topology_summary(cpus, n, &sum, core_cpus);
+    env_key(w, "PACKAGES");
+    writer_int(w, sum.packages);
+    writer_char(w, '\n');
+    env_key(w, "DIES");
+    writer_int(w, sum.dies);
+    writer_char(w, '\n');
+    env_key(w, "CORES");
+    writer_int(w, sum.cores);
+    writer_char(w, '\n');
+    env_key(w, "THREADS");
+    writer_int(w, sum.threads);
+    writer_char(w, '\n');
+    env_key(w, "CORE_CPUS");
+    writer_cpuset(w, core_cpus, sum.cores);
+    writer_char(w, '\n');
+    env_groups(w, cpus, n, group_l3, core_cpus);
+    env_groups(w, cpus, n, group_node, core_cpus);
+    env_key(w, "PCORE_CPUS");
+    writer_cpuset(w, core_cpus,
+                  group_cpus(cpus, n, group_type, core_type_core, core_cpus));
+    writer_char(w, '\n');
+    env_key(w, "ECORE_CPUS");
+    writer_cpuset(w, core_cpus,
+                  group_cpus(cpus, n, group_type, core_type_atom, core_cpus));
+    writer_char(w, '\n');
+    if (dcpu_limits(cpus, n, &lim) == 0)
     {
-      if (HW_AES && HW_PCLMUL)
-      {
-        if (HW_AVX)
-        {
-          if (HW_FSGSBASE && HW_RDRND && HW_F16C)
-          {
-            if (HW_MOVBE && HW_AVX2 && HW_FMA && HW_BMI && HW_BMI2)
-            {
-              if (HW_RDSEED && HW_ADX && HW_PREFETCHW)
-              {
-                if (HW_CLFLUSHOPT && HW_XSAVEC && HW_XSAVES)
-                {
-                  if (HW_PKU && HW_AVX512F && HW_AVX512VL
-                      && HW_AVX512BW && HW_AVX512DQ && HW_AVX512CD)
-                  {
-                    if (HW_CLWB)
-                      {
-                        if (HW_AVX512VNNI)
-                          return intel_cascadelake;
-                        else
-                          return intel_skylake_avx512;
-                      }
-                    else
-                      /* cannonlake doesn't support CLWB! */
-                      if (HW_AVX512VBMI && HW_AVX512IFMA && HW_SHA && HW_UMIP)
-                      {
-                        if (HW_CLWB && HW_RDPID && HW_GFNI && HW_AVX512VBMI2
-                            && HW_AVX512VPOPCNTDQ && HW_AVX512BITALG
-                            && HW_AVX512VNNI && HW_VPCLMULQDQ && HW_VAES)
-                          {
-                            if (HW_PCONFIG)
-                              /* should detect HW_WBNOINVD which is not known */
-                              return intel_icelake_server;
-                            else
-                              return intel_icelake_client;
-                          }
-                        else
-                          return intel_cannonlake;
-                      }
-                  }
-                  else
-                    return intel_skylake;
-                }
-                else
-                  {
-                    if (HW_AVX512F && HW_AVX512PF && HW_AVX512ER && HW_AVX512CD)
-                    {
-                      if (HW_AVX5124VNNIW && HW_AVX5124FMAPS && HW_AVX512VPOPCNTDQ)
-                        return intel_knm;
-                      else
-                        return intel_knl;
-                    }
-                    else
-                      return intel_broadwell;
-                  }
-              }
-              else
-                return intel_haswell;
-            }
-            return intel_ivybridge;
-          }
-          return intel_sandybridge;
-        }
-        else
-        {
-          if (HW_MOVBE && HW_RDRND)
-          {
-            if (HW_XSAVE && HW_XSAVEOPT && HW_FSGSBASE)
-            {
-              if (HW_PTWRITE && HW_RDPID && HW_SGX && HW_UMIP)
-              {
-                if (HW_GFNI_SSE && HW_CLWB)
-                  /* in the documentation HW_ENCLV should be
-                    detected, but this is not documented how ... */
-                  return intel_tremont;
-                else
-                  return intel_goldmont_plus;
-              }
-              else
-                return intel_goldmont;
-            }
-            else
-              return intel_silvermont;
-          }
-          else
-            return intel_westmere;
-        }
-      }
-      return intel_nehalem;
+      env_key(w, "CPUSET");
+      writer_int(w, lim.cpuset);
+      writer_char(w, '\n');
+      env_key(w, "CPU_QUOTA");
+      snprintf(quota, sizeof(quota), "%.2f", lim.quota);
+      writer_str(w, quota);
+      writer_char(w, '\n');
+      env_key(w, "CORE_WORKERS");
+      writer_int(w, lim.core_workers);
+      writer_char(w, '\n');
+      env_key(w, "THREAD_WORKERS");
+      writer_int(w, lim.thread_workers);
+      writer_char(w, '\n');
     }
+  }
 
-    if (HW_MOVBE)
-      return intel_bonnell;
+  free(cpus);
+  free(core_cpus);
+}
 
-    return intel_core2;
+
+int report_env(void)
+{
+  const _cpu_info  *info = dcpu_info();
+  const _cpu_cache *caches;
+  _cpu_tsc          tsc;
+  _writer           w;
+  int               n, i;
+
+  writer_init(&w, output_buffer, sizeof(output_buffer));
+
+  env_key(&w, "VENDOR");
+  writer_shell_string(&w, info->vendor);
+  writer_char(&w, '\n');
+  env_key(&w, "BRAND");
+  writer_shell_string(&w, info->brand);
+  writer_char(&w, '\n');
+  env_key(&w, "CPUID_LEVEL");
+  writer_hex(&w, info->cpuid_level);
+  writer_char(&w, '\n');
+  env_key(&w, "CPUID_EXT_LEVEL");
+  writer_hex(&w, info->cpuid_ext_level);
+  writer_char(&w, '\n');
+  env_key(&w, "SIGNATURE");
+  writer_hex(&w, info->signature);
+  writer_char(&w, '\n');
+  env_key(&w, "ARCH");
+  writer_shell_string(&w, dcpu_arch());
+  writer_char(&w, '\n');
+  env_key(&w, "TUNE");
+  writer_shell_string(&w, dcpu_tune());
+  writer_char(&w, '\n');
+  env_key(&w, "LEVEL");
+  writer_shell_string(&w, dcpu_level());
+  writer_char(&w, '\n');
+  env_key(&w, "XCR0");
+  writer_hex(&w, info->xcr0);
+  writer_char(&w, '\n');
+  env_key(&w, "HYPERVISOR");
+  writer_shell_string(&w, (dcpu_hypervisor() != NULL) ? dcpu_hypervisor() : "");
+  writer_char(&w, '\n');
+  dcpu_tsc_cpuid(&tsc);
+  env_key(&w, "TSC_INVARIANT");
+  writer_uint(&w, tsc.invariant);
+  writer_char(&w, '\n');
+  env_key(&w, "TSC_HZ");
+  writer_uint(&w, tsc.tsc_hz);
+  writer_char(&w, '\n');
+  env_features(&w, "FLAGS", list_usable);
+  env_features(&w, "OS_DISABLED", list_os_disabled);
+  env_features(&w, "MASKED", list_masked);
+
+  caches = dcpu_caches(&n);
+  for (i = 0; i < n; ++i)
+  {
+    env_cache_value(&w, &caches[i], "SIZE", (long long)caches[i].size);
+    env_cache_value(&w, &caches[i], "WAYS", caches[i].ways);
+    env_cache_value(&w, &caches[i], "LINE_SIZE", caches[i].line_size);
+    env_cache_value(&w, &caches[i], "SHARED", caches[i].shared);
   }
-  else
-    return cpu_x86_64;
+
+  env_topology(&w);
+
+  return (writer_flush(&w, STDOUT_FILENO) == 0) ? 0 : 1;
 }
 
 
-int get_gcc_arch_type_amd(void)
+/* report_audit
+
+compares all CPUs against the first probed CPU, returns 0 if all CPUs
+are identical, 1 otherwise
+*/
+
+int report_audit(void)
 {
-  if (HW_MMX && HW_SSE && HW_SSE2)
+  _cpu_audit *cpus;
+  _cpu_audit *ref = NULL;
+  int         n, i, f;
+  int         differ = 0, bad;
+
+  cpus = (_cpu_audit *)malloc(MAX_CPUS * sizeof(_cpu_audit));
+  if ((cpus == NULL) || ((n = dcpu_audit(cpus, MAX_CPUS)) < 0))
   {
-    if (HW_SSE3 && HW_SSSE3 && HW_SSE4A && HW_CX16 && HW_ABM)
-    {
-      if (HW_AVX && HW_AES && HW_PCLMUL && HW_SSE41 && HW_SSE42 )
-      {
-        //printf("test1\n");
-        if (HW_MOVBE && HW_F16C && HW_BMI)
-        {
-          /* ZEN micro tech */
-          if (HW_BMI2 && HW_FMA && HW_FSGSBASE && HW_AVX2 && HW_ADCX
-              && HW_RDSEED && HW_MWAITX && HW_SHA && HW_CLZERO
-              && HW_XSAVEC && HW_XSAVES && HW_CLFLUSHOPT && HW_POPCNT)
-          {
-            if (HW_CLWB)
-              return amd_znver2;
-            else
-              return amd_znver1;
-          }
-          else
-            return amd_btver2;
-        }
+    fprintf(stderr, "Cannot audit the CPUs!\n");
+    free(cpus);
+    return 2;
+  }
 
-        if (HW_FMA4 && HW_XOP && HW_LWP)
-        {
-          //printf("test2\n");
-          if (HW_BMI && HW_TBM && HW_F16C && HW_FMA)
-          {
-            //printf("test3\n");
-            if (HW_FSGSBASE)
-            {
-              if (HW_BMI2 && HW_AVX2 && HW_MOVBE)
-                return amd_bdver4;
-              else
-                return amd_bdver3;
-            }
-            else
-              return amd_bdver2;
-          }
-          else
-            return amd_bdver1;
-        }
-      }
-      else
-        return amd_btver1;
+  for (i = 0; i < n; ++i)
+  {
+    if (!cpus[i].valid)
+    {
+      printf("CPU %d: not probed\n", cpus[i].cpu);
+      ++differ;
+      continue;
+    }
+    if (ref == NULL)
+    {
+      ref = &cpus[i];
+      printf("Reference CPU  : %d\n", ref->cpu);
+      printf("Signature      : 0x%x\n", ref->signature);
+      printf("Microcode      : 0x%lx\n", ref->microcode);
+      continue;
     }
 
-    if (HW_3DNOW && HW_3DNOWEXT)
+    bad = 0;
+    if (cpus[i].signature != ref->signature)
     {
-      if (HW_SSE3)
-      {
-        if (HW_SSE4A && HW_ABM)
-          return amd_amdfam10;
-        else
-          return amd_athlon64_sse3;
-      }
-      else
-        return amd_athlon64;
+      printf("CPU %d: signature 0x%x\n", cpus[i].cpu, cpus[i].signature);
+      bad = 1;
+    }
+    if (cpus[i].microcode != ref->microcode)
+    {
+      printf("CPU %d: microcode 0x%lx\n", cpus[i].cpu, cpus[i].microcode);
+      bad = 1;
     }
+    if (strcmp(cpus[i].brand, ref->brand) != 0)
+    {
+      printf("CPU %d: brand %s\n", cpus[i].cpu, cpus[i].brand);
+      bad = 1;
+    }
+    if (!featureset_contains(&cpus[i].features, &ref->features)
+        || !featureset_contains(&ref->features, &cpus[i].features))
+    {
+      printf("CPU %d: flags", cpus[i].cpu);
+      for (f = 0; f < HW_NUM_FEATURES; ++f)
+        if (featureset_has(&cpus[i].features, f)
+            != featureset_has(&ref->features, f))
+          printf(" %c%s", featureset_has(&cpus[i].features, f) ? '+' : '-',
+                 dcpu_feature_name(f));
+      printf("\n");
+      bad = 1;
+    }
+    differ += bad;
   }
 
-  return cpu_x86_64;
+  if (differ == 0)
+    printf("all %d CPUs are identical\n", n);
+  else
+    printf("%d of %d CPUs differ\n", differ, n);
+
+  free(cpus);
+
+  return differ ? 1 : 0;
 }
 
-int get_gcc_arch_type(void)
+
+/* query_at_least
+
+exit code 0 if the CPU supports all features of the gcc arch or
+x86-64 level, 1 if not, 2 for an unknown name
+*/
+
+int query_at_least(const char *name)
+{
+  int arch = dcpu_arch_id(name);
+
+  if (arch < 0)
+    return 2;
+
+  return dcpu_supports_arch(arch) ? 0 : 1;
+}
+
+
+/* query_has
+
+exit code 0 if the CPU has all features of the comma separated
+list, 1 if not, 2 for an unknown feature name or an empty list
+*/
+
+int query_has(char *list)
 {
-  switch(cpu_type)
+  char *name;
+  int   feature;
+  int   ret = 0, n = 0;
+
+  for (name = strtok(list, ","); name != NULL; name = strtok(NULL, ","))
   {
-    case CPU_Intel:
-        return get_gcc_arch_type_intel();
-        break;
-    case CPU_AMD:
-        return get_gcc_arch_type_amd();
-        break;
+    feature = dcpu_feature_id(name);
+    if (feature < 0)
+      return 2;
+    if (!dcpu_has(feature))
+      ret = 1;
+    ++n;
+  }
+
+  /* nothing asked is no answer */
+  if (n == 0)
+    return 2;
+
+  return ret;
+}
+
+
+/* print_feature_list
+
+prints a line with the features of a list and an optional note,
+empty lists are skipped
+*/
+
+void print_feature_list(const char *label, int list, const char *note)
+{
+  int i, n;
+
+  for (i = 0, n = 0; i < HW_NUM_FEATURES; ++i)
+    n += feature_listed(i, list);
+  if (n == 0)
+    return;
+
+  printf("%-15s:", label);
+  for (i = 0; i < HW_NUM_FEATURES; ++i)
+    if (feature_listed(i, list))
+      printf(" %s", dcpu_feature_name(i));
+  if (note != NULL)
+    printf(" (%s)", note);
+  printf("\n");
+}
+
+
+void all_cpu_flags(void)
+{
+  char note[64];
+  int  i;
+
+  printf("Flags          :");
+  for (i = 0; i < HW_NUM_FEATURES; ++i)
+    if (dcpu_has(i))
+      printf(" %s", dcpu_feature_name(i));
+  printf(" \n");
+
+  print_feature_list("OS disabled", list_os_disabled, NULL);
+  print_feature_list("Kernel disabled", list_kernel_disabled, NULL);
+  print_feature_list("Kernel only", list_kernel_only, NULL);
+  /* a hypervisor, the firmware or a fused off SKU, CPUID doesn't say */
+  snprintf(note, sizeof(note), "expected for %s", dcpu_tune());
+  print_feature_list("Absent", list_masked, note);
+}
+
+
+/* report_gcc_flags
+
+prints the gcc options for exactly this host, like -march=native
+does: the arch with explicit -mno-/-m corrections, -mtune for the
+model if the features forced a lower arch, and the cache parameters
+*/
+
+int report_gcc_flags(int gcc)
+{
+  char              flags[2048];
+  const _cpu_cache *cache;
+  int               arch, tune;
+
+  arch = dcpu_gcc_arch(dcpu_cpu.arch, gcc);
+  tune = dcpu_gcc_arch(dcpu_cpu.tune, gcc);
+  if (dcpu_gcc_flags_for(arch, &dcpu_cpu.features, gcc, flags,
+                         sizeof(flags)) < 0)
+    return 1;
+
+  printf("%s", flags);
+
+  /* the levels are no -mtune targets */
+  if ((tune != arch) && (tune > cpu_x86_64_v4))
+    printf(" -mtune=%s", dcpu_arch_name(tune));
+
+  cache = dcpu_cache(1, cache_data);
+  if (cache != NULL)
+    printf(" --param l1-cache-size=%lu --param l1-cache-line-size=%d",
+           cache->size / 1024, cache->line_size);
+  cache = dcpu_cache(2, cache_data);
+  if (cache != NULL)
+    printf(" --param l2-cache-size=%lu", cache->size / 1024);
+  printf("\n");
+
+  return 0;
+}
+
+
+const char *cgroup_name(int cgroup)
+{
+  switch (cgroup)
+  {
+    case cgroup_v1:
+      return "v1";
+    case cgroup_v2:
+      return "v2";
     default:
-        return cpu_x86_64;
-        break;
+      return "none";
   }
 }
 
 
-void report_cpu_data(void)
+/* report_workers
+
+prints the CPUs the process may use and the recommended number of
+workers
+*/
+
+int report_workers(void)
+{
+  _cpu_topology *cpus;
+  _cpu_limits    lim;
+  int            n;
+
+  cpus = (_cpu_topology *)malloc(MAX_CPUS * sizeof(_cpu_topology));
+  if ((cpus == NULL) || ((n = dcpu_topology(cpus, MAX_CPUS)) < 0)
+      || (dcpu_limits(cpus, n, &lim) != 0))
+  {
+    fprintf(stderr, "Cannot read the CPU limits!\n");
+    free(cpus);
+    return 1;
+  }
+  free(cpus);
+
+  printf("Online CPUs    : %d\n", lim.online);
+  printf("Affinity CPUs  : %d\n", lim.affinity);
+  printf("Cgroup         : %s\n", cgroup_name(lim.cgroup));
+  if (lim.cpuset > 0)
+    printf("Cpuset CPUs    : %d\n", lim.cpuset);
+  else
+    printf("Cpuset CPUs    : no limit\n");
+  if (lim.quota > 0.0)
+    printf("CPU quota      : %.2f CPUs\n", lim.quota);
+  else
+    printf("CPU quota      : no limit\n");
+  printf("Cores/threads  : %d/%d\n", lim.cores, lim.threads);
+  printf("Workers        : %d per core, %d per thread\n", lim.core_workers,
+         lim.thread_workers);
+
+  return 0;
+}
+
+
+/* writer_omp_places
+
+writes one OpenMP place per physical core with all its threads,
+e.g. {0,64},{1,65}
+*/
+
+void writer_omp_places(_writer *w, const _cpu_topology *cpus, int n)
 {
-  printf("Vendor         : %s\n", cpu_id_str);
-  printf("Brand          : %s\n", cpu_brand);
-  printf("cpuid level    : 0x%x\n", cpuid_level);
-  printf("cpuid ext level: 0x%x\n", cpuid_ext_level);
+  int i, j, seen, first = 1;
+
+  for (i = 0; i < n; ++i)
+  {
+    if (!cpus[i].valid)
+      continue;
+    for (seen = 0, j = 0; (j < i) && !seen; ++j)
+      seen = cpus[j].valid && (cpus[j].package_id == cpus[i].package_id)
+             && (cpus[j].die_id == cpus[i].die_id)
+             && (cpus[j].module_id == cpus[i].module_id)
+             && (cpus[j].core_id == cpus[i].core_id);
+    if (seen)
+      continue;
+
+    writer_str(w, first ? "{" : ",{");
+    first = 0;
+    writer_int(w, cpus[i].cpu);
+    for (j = i + 1; j < n; ++j)
+      if (cpus[j].valid && (cpus[j].package_id == cpus[i].package_id)
+          && (cpus[j].die_id == cpus[i].die_id)
+          && (cpus[j].module_id == cpus[i].module_id)
+          && (cpus[j].core_id == cpus[i].core_id))
+      {
+        writer_char(w, ',');
+        writer_int(w, cpus[j].cpu);
+      }
+    writer_char(w, '}');
+  }
 }
 
 
-void cpu_arch_type(void)
+/* report_exports
+
+prints shell exports for the runtimes which otherwise size their
+thread pools by all CPUs of the host: OpenMP gets one thread per
+core, Go one per thread. The libraries with their own CPU dispatch
+follow, see exports.c
+*/
+
+int report_exports(void)
 {
-  char *s;
-  int   arch;
+  _cpu_topology *cpus;
+  _cpu_limits    lim;
+  _writer        w;
+  int            n;
+
+  cpus = (_cpu_topology *)malloc(MAX_CPUS * sizeof(_cpu_topology));
+  if ((cpus == NULL) || ((n = dcpu_topology(cpus, MAX_CPUS)) < 0)
+      || (dcpu_limits(cpus, n, &lim) != 0))
+  {
+    fprintf(stderr, "Cannot read the CPU limits!\n");
+    free(cpus);
+    return 1;
+  }
 
-  arch = get_gcc_arch_type();
+  writer_init(&w, output_buffer, sizeof(output_buffer));
 
-  s = get_arch_name(arch);
+  writer_str(&w, "export OMP_NUM_THREADS=");
+  writer_int(&w, lim.core_workers);
+  writer_str(&w, "\nexport OMP_PLACES='");
+  writer_omp_places(&w, cpus, n);
+  writer_str(&w, "'\nexport OMP_PROC_BIND=spread\n");
+  writer_str(&w, "export GOMAXPROCS=");
+  writer_int(&w, lim.thread_workers);
+  writer_char(&w, '\n');
+  writer_library_exports(&w);
 
-  printf("%s\n", s);
+  free(cpus);
+
+  return (writer_flush(&w, STDOUT_FILENO) == 0) ? 0 : 1;
 }
 
 
-void all_cpu_flags(void)
+/* report_tsc
+
+prints the TSC properties, the frequency and the clocks of leaf 16h
+*/
+
+int report_tsc(void)
+{
+  _cpu_tsc tsc;
+
+  dcpu_tsc(&tsc);
+
+  printf("TSC            : %s\n", tsc.invariant ? "invariant" : "not invariant");
+  if (tsc.tsc_hz != 0)
+    printf("TSC frequency  : %.6f MHz (%s)\n", tsc.tsc_hz / 1e6,
+           tsc_source_name(tsc.source));
+  else
+    printf("TSC frequency  : unknown\n");
+  if (tsc.ns_per_tick > 0.0)
+    printf("ns per tick    : %.9f\n", tsc.ns_per_tick);
+  if (tsc.crystal_hz != 0)
+    printf("Crystal clock  : %.3f MHz\n", tsc.crystal_hz / 1e6);
+  if (tsc.base_mhz != 0)
+    printf("Base/max/bus   : %u/%u/%u MHz\n", tsc.base_mhz, tsc.max_mhz,
+           tsc.bus_mhz);
+
+  return 0;
+}
+
+
+/* report_simd
+
+prints the measured SIMD throughput and the vector width to
+prefer
+*/
+
+int report_simd(void)
+{
+  _cpu_simd simd;
+  int       w;
+
+  dcpu_simd_probe(&simd);
+
+  printf("Width          : FMA GFLOP/s   int Gop/s\n");
+  for (w = 0; w < DCPU_SIMD_WIDTHS; ++w)
+  {
+    printf("%3d bit        :", 128 << w);
+    if (simd.fma[w] > 0.0)
+      printf(" %11.1f", simd.fma[w]);
+    else
+      printf(" %11s", "-");
+    if (simd.integer[w] > 0.0)
+      printf(" %11.1f\n", simd.integer[w]);
+    else
+      printf(" %11s\n", "-");
+  }
+  printf("Recommended    : -mprefer-vector-width=%d\n", simd.prefer_width);
+
+  return 0;
+}
+
+
+/* print_type_only
+
+prints the features of the core type which the other one lacks
+*/
+
+void print_type_only(const char *label, const _cpu_featureset *set,
+                     const _cpu_featureset *other)
 {
-  #define mc 5000
-  char *s;
-
-  s = (char*) malloc(mc);
-  s[0] = '\0';
-
-  if (HW_FPU) strncat(s, "fpu ", mc);
-  if (HW_VME) strncat(s, "vme ", mc);
-  if (HW_DE) strncat(s, "de ", mc);
-  if (HW_PSE) strncat(s, "pse ", mc);
-  if (HW_TSC) strncat(s, "tsc ", mc);
-  if (HW_MSR) strncat(s, "msr ", mc);
-  if (HW_PAE) strncat(s, "pae ", mc);
-  if (HW_MCE) strncat(s, "mce ", mc);
-  if (HW_CX8) strncat(s, "cx8 ", mc);
-  if (HW_APIC) strncat(s, "apic ", mc);
-
-  if (HW_SEP) strncat(s, "sep ", mc);
-  if (HW_MTRR) strncat(s, "mtrr ", mc);
-  if (HW_PGE) strncat(s, "pge ", mc);
-  if (HW_MCA) strncat(s, "mca ", mc);
-  if (HW_CMOV) strncat(s, "cmov ", mc);
-  if (HW_PAT) strncat(s, "pat ", mc);
-  if (HW_PSE36) strncat(s, "pse36 ", mc);
-  if (HW_PSN) strncat(s, "psn ", mc);
-  if (HW_CLFLUSH) strncat(s, "clflush ", mc);
-
-  if (HW_DS) strncat(s, "ds ", mc);
-  if (HW_ACPI) strncat(s, "acpi ", mc);
-  if (HW_MMX) strncat(s, "mmx ", mc);
-  if (HW_FXSR) strncat(s, "fxsr ", mc);
-  if (HW_SSE) strncat(s, "sse ", mc);
-  if (HW_SSE2) strncat(s, "sse2 ", mc);
-  if (HW_SS) strncat(s, "ss ", mc);
-  if (HW_HTT) strncat(s, "ht ", mc);
-  if (HW_TM) strncat(s, "tm ", mc);
-  if (HW_IA64) strncat(s, "ia64 ", mc);
-  if (HW_PBE) strncat(s, "pbe ", mc);
-
-  if (HW_SYSCALL) strncat(s, "syscall ", mc);
-  if (HW_MP) strncat(s, "mp ", mc);
-  if (HW_NX) strncat(s, "nx ", mc);
-  if (HW_MMEXT) strncat(s, "mmext ", mc);
-  if (HW_FXSR_OPT) strncat(s, "fxsr_opt ", mc);
-  if (HW_PDPE1GB) strncat(s, "pdpe1gb ", mc);
-  if (HW_RDTSCP) strncat(s, "rdtscp ", mc);
-  if (HW_LM) strncat(s, "lm ", mc);
-  if (HW_3DNOWEXT) strncat(s, "3dnowext ", mc);
-  if (HW_3DNOW) strncat(s, "3dnow ", mc);
-
-
-  if (HW_LAHF_LM) strncat(s, "lahf_lm ", mc);
-  if (HW_CMP_LEGACY) strncat(s, "cmp_legacy ", mc);
-  if (HW_SVM) strncat(s, "svm ", mc);
-  if (HW_EXTAPIC) strncat(s, "extapic ", mc);
-  if (HW_CR8_LEGACY) strncat(s, "cr8_legacy ", mc);
-  if (HW_ABM) strncat(s, "abm ", mc);
-  if (HW_SSE4A) strncat(s, "sse4a ", mc);
-  if (HW_MISALIGNSSE) strncat(s, "misalignsse ", mc);
-  if (HW_3DNOWPREFETCH) strncat(s, "3dnowprefetch ", mc);
-  if (HW_OSVW) strncat(s, "osvw ", mc);
-  if (HW_IBS) strncat(s, "ibs ", mc);
-  if (HW_XOP) strncat(s, "xop ", mc);
-  if (HW_SKINIT) strncat(s, "skinit ", mc);
-  if (HW_WDT) strncat(s, "wdt ", mc);
-  if (HW_LWP) strncat(s, "lwp ", mc);
-  if (HW_FMA4) strncat(s, "fma4 ", mc);
-  if (HW_TCE) strncat(s, "tce ", mc);
-  if (HW_NODEID_MSR) strncat(s, "nodeid_msr ", mc);
-  if (HW_TBM) strncat(s, "tbm ", mc);
-  if (HW_TOPOEXT) strncat(s, "topoext ", mc);
-  if (HW_PERFCTR_CORE) strncat(s, "perfctr_core ", mc);
-  if (HW_PERFCTR_NB) strncat(s, "perfctr_nb ", mc);
-  if (HW_DBX) strncat(s, "dbx ", mc);
-  if (HW_PERFTSC) strncat(s, "perftsc ", mc);
-  if (HW_PCX_L2I) strncat(s, "pcx_l2i ", mc);
-  if (HW_MWAITX) strncat(s, "mwaitx ", mc);
-
-  if (HW_SSE3) strncat(s, "sse3 ", mc);
-  if (HW_PCLMUL) strncat(s, "pclmul ", mc);
-  if (HW_DTES64) strncat(s, "dtes64 ", mc);
-  if (HW_MONITOR) strncat(s, "monitor ", mc);
-  if (HW_DS_CPL) strncat(s, "ds_cpl ", mc);
-  if (HW_VMX) strncat(s, "vmx ", mc);
-  if (HW_SMX) strncat(s, "smx ", mc);
-  if (HW_EST) strncat(s, "est ", mc);
-  if (HW_TM2) strncat(s, "tm2 ", mc);
-  if (HW_SSSE3) strncat(s, "ssse3 ", mc);
-  if (HW_CNXT_ID) strncat(s, "cnxt_id ", mc);
-  if (HW_SDBG) strncat(s, "sdbg ", mc);
-  if (HW_FMA) strncat(s, "fma ", mc);
-  if (HW_CX16) strncat(s, "cx16 ", mc);
-  if (HW_XTPR) strncat(s, "xtpr ", mc);
-  if (HW_PDCM) strncat(s, "pdcm ", mc);
-  if (HW_PCID) strncat(s, "pcid ", mc);
-  if (HW_DCA) strncat(s, "dca ", mc);
-  if (HW_SSE41) strncat(s, "sse41 ", mc);
-  if (HW_SSE42) strncat(s, "sse42 ", mc);
-  if (HW_X2APIC) strncat(s, "x2apic ", mc);
-  if (HW_MOVBE) strncat(s, "movbe ", mc);
-  if (HW_POPCNT) strncat(s, "popcnt ", mc);
-  if (HW_TSC_DEADLINE) strncat(s, "tsc_deadline ", mc);
-  if (HW_AES) strncat(s, "aes ", mc);
-  if (HW_XSAVE) strncat(s, "xsave ", mc);
-  if (HW_OSXSAVE) strncat(s, "osxsave ", mc);
-  if (HW_AVX) strncat(s, "avx ", mc);
-  if (HW_F16C) strncat(s, "f16c ", mc);
-  if (HW_RDRND) strncat(s, "rdrnd ", mc);
-  if (HW_HYPERVISOR) strncat(s, "hypervisor ", mc);
-
-  if (HW_FSGSBASE) strncat(s, "fsgsbase ", mc);
-  if (HW_SGX) strncat(s, "sgx ", mc);
-  if (HW_BMI) strncat(s, "bmi ", mc);
-  if (HW_HLE) strncat(s, "hle ", mc);
-  if (HW_AVX2) strncat(s, "avx2 ", mc);
-  if (HW_SMEP) strncat(s, "smep ", mc);
-  if (HW_BMI2) strncat(s, "bmi2 ", mc);
-  if (HW_ERMS) strncat(s, "erms ", mc);
-  if (HW_INVPCID) strncat(s, "invpcid ", mc);
-  if (HW_RTM) strncat(s, "rtm ", mc);
-  if (HW_PQM) strncat(s, "pqm ", mc);
-  if (HW_MPX) strncat(s, "mpx ", mc);
-  if (HW_PQE) strncat(s, "pqe ", mc);
-  if (HW_AVX512F) strncat(s, "avx512f ", mc);
-  if (HW_AVX512DQ) strncat(s, "avx512dq ", mc);
-  if (HW_RDSEED) strncat(s, "rdseed ", mc);
-  if (HW_ADX) strncat(s, "adx ", mc);
-  if (HW_SMAP) strncat(s, "smap ", mc);
-  if (HW_AVX512IFMA) strncat(s, "avx512ifma ", mc);
-  if (HW_PCOMMIT) strncat(s, "pcommit ", mc);
-  if (HW_CLFLUSHOPT) strncat(s, "clflushopt ", mc);
-  if (HW_CLWB) strncat(s, "clwb ", mc);
-  if (HW_INTEL_PT) strncat(s, "intel_pt ", mc);
-  if (HW_AVX512PF) strncat(s, "avx512pf ", mc);
-  if (HW_AVX512ER) strncat(s, "avx512er ", mc);
-  if (HW_AVX512CD) strncat(s, "avx512cd ", mc);
-  if (HW_SHA) strncat(s, "sha ", mc);
-  if (HW_AVX512BW) strncat(s, "avx512bw ", mc);
-  if (HW_AVX512VL) strncat(s, "avx512vl ", mc);
-
-  if (HW_PREFETCHWT1) strncat(s, "prefetchwt1 ", mc);
-  if (HW_AVX512VBMI) strncat(s, "avx512vbmi ", mc);
-  if (HW_UMIP) strncat(s, "umip ", mc);
-  if (HW_PKU) strncat(s, "pku ", mc);
-  if (HW_OSPKE) strncat(s, "ospke ", mc);
-  if (HW_AVX512VBMI2) strncat(s, "avx512vbmi2 ", mc);
-  if (HW_GFNI) strncat(s, "gfni ", mc);
-  if (HW_VAES) strncat(s, "vaes ", mc);
-  if (HW_VPCLMULQDQ) strncat(s, "vpclmulqdq ", mc);
-  if (HW_AVX512VNNI) strncat(s, "avx512vmni ", mc);
-  if (HW_AVX512BITALG) strncat(s, "avx512bitalg ", mc);
-  if (HW_AVX512VPOPCNTDQ) strncat(s, "avx512vpopcntdq ", mc);
-  if (HW_RDPID) strncat(s, "rdpid ", mc);
-  if (HW_SGX_LC) strncat(s, "sgx_lc ", mc);
-
-  if (HW_AVX5124VNNIW) strncat(s, "avx5124vnniw ", mc);
-  if (HW_AVX5124FMAPS) strncat(s, "avx5124fmaps ", mc);
-  if (HW_PCONFIG) strncat(s, "pconfig ", mc);
-
-  if (HW_CLZERO) strncat(s, "clzero ", mc);
-
-  if (HW_XSAVEOPT) strncat(s, "xsaveopt ", mc);
-  if (HW_XSAVEC) strncat(s, "xsavec ", mc);
-  if (HW_XGETBV) strncat(s, "xgetbv ", mc);
-  if (HW_XSAVES) strncat(s, "xsaves ", mc);
-
-  if (HW_PTWRITE) strncat(s, "ptwrite ", mc);
-
-  printf("Flags          : %s\n", s);
-  free(s);
+  int f, n = 0;
+
+  printf("%s", label);
+  for (f = 0; f < HW_NUM_FEATURES; ++f)
+    if (featureset_has(set, f) && !featureset_has(other, f))
+    {
+      printf(" %s", dcpu_feature_name(f));
+      ++n;
+    }
+  printf("%s\n", (n == 0) ? " -" : "");
+}
+
+
+/* report_hybrid
+
+prints the P- and E-cores of a hybrid CPU and the features all CPUs
+share, code running on any CPU may only use those
+*/
+
+int report_hybrid(void)
+{
+  _cpu_audit     *cpus;
+  _cpu_featureset common, pcores, ecores;
+  int            *list;
+  int             n, i, np = 0, ne = 0;
+
+  cpus = (_cpu_audit *)malloc(MAX_CPUS * sizeof(_cpu_audit));
+  list = (int *)malloc(MAX_CPUS * sizeof(int));
+  if ((cpus == NULL) || (list == NULL)
+      || ((n = dcpu_audit(cpus, MAX_CPUS)) < 0))
+  {
+    fprintf(stderr, "Cannot audit the CPUs!\n");
+    free(cpus);
+    free(list);
+    return 2;
+  }
+
+  printf("Hybrid         : %s\n", dcpu_has(HW_HYBRID) ? "yes" : "no");
+  for (i = 0; i < n; ++i)
+    if (cpus[i].valid && (cpus[i].core_type == core_type_core))
+      list[np++] = cpus[i].cpu;
+  if (np > 0)
+  {
+    printf("P-cores        : ");
+    print_cpuset(list, np);
+    printf("\n");
+  }
+  for (i = 0; i < n; ++i)
+    if (cpus[i].valid && (cpus[i].core_type == core_type_atom))
+      list[ne++] = cpus[i].cpu;
+  if (ne > 0)
+  {
+    printf("E-cores        : ");
+    print_cpuset(list, ne);
+    printf("\n");
+  }
+
+  dcpu_audit_common(cpus, n, core_type_any, &common);
+  i = dcpu_classify(dcpu_cpu.cpu_type, &common);
+  printf("Common arch    : %s (%s)\n", dcpu_arch_name(i),
+         dcpu_arch_name(dcpu_classify_level(&common)));
+  if ((np > 0) && (ne > 0))
+  {
+    dcpu_audit_common(cpus, n, core_type_core, &pcores);
+    dcpu_audit_common(cpus, n, core_type_atom, &ecores);
+    print_type_only("P-core only    :", &pcores, &ecores);
+    print_type_only("E-core only    :", &ecores, &pcores);
+  }
+
+  free(cpus);
+  free(list);
+
+  return 0;
 }
 
 
-#define action_arch 0
-#define action_info 1
+#define action_arch     0
+#define action_info     1
+#define action_level    2
+#define action_at_least 3
+#define action_has      4
+#define action_cache    5
+#define action_topology 6
+#define action_audit    7
+#define action_json     8
+#define action_env      9
+#define action_flags    10
+#define action_dump     11
+#define action_fleet    12
+#define action_simd     13
+#define action_tsc      14
+#define action_workers  15
+#define action_exports  16
+#define action_exec     17
+#define action_hybrid   18
+
+static struct option long_options[] = {
+  {"level",    no_argument,       NULL, 'l'},
+  {"cache",    no_argument,       NULL, 'c'},
+  {"topology", no_argument,       NULL, 't'},
+  {"audit",    no_argument,       NULL, 'A'},
+  {"json",     no_argument,       NULL, 'j'},
+  {"env",      no_argument,       NULL, 'e'},
+  {"flags",    no_argument,       NULL, 'f'},
+  {"dump",     required_argument, NULL, 'd'},
+  {"replay",   required_argument, NULL, 'r'},
+  {"fleet",    required_argument, NULL, 'F'},
+  {"simd",     no_argument,       NULL, 's'},
+  {"tsc",      no_argument,       NULL, 'T'},
+  {"effective", no_argument,      NULL, 'E'},
+  {"workers",  no_argument,       NULL, 'W'},
+  {"exports",  no_argument,       NULL, 'X'},
+  {"exec",     required_argument, NULL, 'x'},
+  {"hybrid",   no_argument,       NULL, 'Y'},
+  {"gcc",      required_argument, NULL, 'G'},
+  {"at-least", required_argument, NULL, 'L'},
+  {"has",      required_argument, NULL, 'H'},
+  {NULL,       0,                 NULL, 0}
+};
 
 int main(int argc, char* argv[])
 {
-    int ch;
+    int   ch;
+    char *query = NULL;
+    char *replay = NULL;
+    int   gcc = 0;
+    int   use_effective = 0;
 
     int action = action_arch;
 
-    while ((ch = getopt(argc, argv, "av")) != -1)
+    /* everything after --exec BASE belongs to the executed build */
+    while ((action != action_exec)
+           && ((ch = getopt_long(argc, argv, "+avlctAjefsTEWXYL:H:d:r:F:G:x:", long_options, NULL)) != -1))
         switch(ch)
         {
           case 'a':
@@ -1138,20 +1397,157 @@ int main(int argc, char* argv[])
             break;
           case 'v':
             break;
+          case 'l':
+            action = action_level;
+            break;
+          case 'c':
+            action = action_cache;
+            break;
+          case 't':
+            action = action_topology;
+            break;
+          case 'A':
+            action = action_audit;
+            break;
+          case 'j':
+            action = action_json;
+            break;
+          case 'e':
+            action = action_env;
+            break;
+          case 'f':
+            action = action_flags;
+            break;
+          case 'L':
+            action = action_at_least;
+            query = optarg;
+            break;
+          case 'H':
+            action = action_has;
+            query = optarg;
+            break;
+          case 'd':
+            action = action_dump;
+            query = optarg;
+            break;
+          case 'r':
+            replay = optarg;
+            break;
+          case 'G':
+            gcc = atoi(optarg);
+            break;
+          case 's':
+            action = action_simd;
+            break;
+          case 'T':
+            action = action_tsc;
+            break;
+          case 'E':
+            use_effective = 1;
+            break;
+          case 'W':
+            action = action_workers;
+            break;
+          case 'X':
+            action = action_exports;
+            break;
+          case 'Y':
+            action = action_hybrid;
+            break;
+          case 'x':
+            action = action_exec;
+            query = optarg;
+            break;
+          case 'F':
+            action = action_fleet;
+            query = optarg;
+            break;
+          default:
+            return 2;
         }
 
     /* detect all flags */
-    get_cpu_flags();
+    dcpu_init();
+
+    if ((replay != NULL) && (dcpu_cpuid_replay(replay) != 0))
+    {
+      fprintf(stderr, "Cannot replay the cpuid dump '%s'!\n", replay);
+      return 2;
+    }
+
+    /* the per-CPU modes probe the local CPUs, not the ones of a dump */
+    if ((replay != NULL)
+        && ((action == action_topology) || (action == action_audit)
+            || (action == action_workers) || (action == action_exports)
+            || (action == action_hybrid)))
+    {
+      fprintf(stderr, "The per-CPU modes don't work with a replayed dump!\n");
+      return 2;
+    }
+
+    /* without CPUID only the kernel knows the features */
+    if (use_effective || dcpu_cpu.cpuid_faulting)
+    {
+      if (dcpu_effective(&effective) != 0)
+      {
+        fprintf(stderr, "Neither CPUID nor /proc/cpuinfo is available!\n");
+        return 2;
+      }
+      dcpu_use_effective(&effective);
+      effective_used = 1;
+    }
 
     switch(action)
     {
       case action_arch:
-        cpu_arch_type();
+        cpu_arch_type(gcc);
         break;
       case action_info:
         report_cpu_data();
         all_cpu_flags();
         break;
+      case action_level:
+        printf("%s\n", dcpu_level());
+        break;
+      case action_cache:
+        report_caches();
+        break;
+      case action_topology:
+        report_topology();
+        break;
+      case action_audit:
+        return report_audit();
+      case action_json:
+        return report_json();
+      case action_env:
+        return report_env();
+      case action_flags:
+        return report_gcc_flags(gcc);
+      case action_dump:
+        if (dcpu_cpuid_record(query) != 0)
+        {
+          fprintf(stderr, "Cannot write the cpuid dump '%s'!\n", query);
+          return 1;
+        }
+        break;
+      case action_simd:
+        return report_simd();
+      case action_tsc:
+        return report_tsc();
+      case action_workers:
+        return report_workers();
+      case action_exports:
+        return report_exports();
+      case action_hybrid:
+        return report_hybrid();
+      case action_exec:
+        return exec_best(query, argv + optind);
+      case action_fleet:
+        return report_fleet(query);
+      case action_at_least:
+        return query_at_least(query);
+      case action_has:
+        return query_has(query);
     }
 
 
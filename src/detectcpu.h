@@ -0,0 +1,557 @@
+/* detectcpu.h
+
+written by: Oliver Cordes 2019-07-01
+changed by: Oliver Cordes 2019-07-01
+
+*/
+
+/* public C API of the libdetectcpu library
+
+   the detection runs exactly once, either explicitly with dcpu_init()
+   or lazily on the first query. After the initialization a feature
+   test is a single (predictable) branch plus a load and a mask.
+*/
+
+#ifndef DETECTCPU_H
+#define DETECTCPU_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#if defined(__GNUC__) && !defined(_WIN32)
+#define DCPU_API __attribute__((visibility("default")))
+#else
+#define DCPU_API
+#endif
+
+
+/* CPU vendors */
+
+#define CPU_UNKNOWN   0
+#define CPU_Intel     1
+#define CPU_AMD       2
+#define CPU_Centauer  3
+#define CPU_Cyrix     4
+#define CPU_Hygon     5
+#define CPU_Transmeta 6
+#define CPU_NSC       7
+#define CPU_NexGen    8
+#define CPU_Rise      9
+#define CPU_SiS       10
+#define CPU_UMC       11
+#define CPU_VIA       12
+#define CPU_Vortex    13
+#define CPU_Zhaoxin   14
+
+
+/* hypervisors, from the signature of leaf 40000000h */
+
+#define HV_NONE       0      /* bare metal */
+#define HV_UNKNOWN    1
+#define HV_KVM        2
+#define HV_HYPERV     3
+#define HV_VMWARE     4
+#define HV_XEN        5
+#define HV_QEMU       6      /* TCG, without KVM */
+#define HV_VIRTUALBOX 7
+#define HV_PARALLELS  8
+#define HV_BHYVE      9
+#define HV_ACRN       10
+#define HV_QNX        11
+
+
+/* CPU feature flags
+
+   the features are described in cpu_features.h, the detected features
+   are stored as a packed bitset, a feature test is a single load
+   and mask
+*/
+
+#define REG_EAX 0
+#define REG_EBX 1
+#define REG_ECX 2
+#define REG_EDX 3
+
+enum {
+#define CPU_FEATURE(id, leaf, subleaf, reg, bit, name, gcc, gccver) id,
+#include "cpu_features.h"
+#undef CPU_FEATURE
+  HW_NUM_FEATURES
+};
+
+/* terminator of feature lists */
+#define HW_END (-1)
+
+/* alias names */
+#define HW_MWAIT      HW_MONITOR
+#define HW_MWAITT     HW_MWAITX
+#define HW_ADCX       HW_ADX
+#define HW_GFNI_SSE   HW_GFNI
+#define HW_x64        HW_LM
+#define HW_PREFETCHW  HW_3DNOWPREFETCH
+
+
+#define HW_WORDS ((HW_NUM_FEATURES + 63) / 64)
+
+typedef struct {
+  uint64_t bits[HW_WORDS];
+} _cpu_featureset;
+
+#define featureset_has(set, f) \
+  (((set)->bits[(f) >> 6] >> ((f) & 63)) & 1)
+#define featureset_set(set, f) \
+  ((set)->bits[(f) >> 6] |= (uint64_t)1 << ((f) & 63))
+#define featureset_unset(set, f) \
+  ((set)->bits[(f) >> 6] &= ~((uint64_t)1 << ((f) & 63)))
+
+
+static inline void featureset_clear(_cpu_featureset *set)
+{
+  int i;
+
+  for (i = 0; i < HW_WORDS; ++i)
+    set->bits[i] = 0;
+}
+
+
+/* featureset_contains
+
+returns 1 if all features of req are also in set
+*/
+
+static inline int featureset_contains(const _cpu_featureset *set,
+                                      const _cpu_featureset *req)
+{
+  int i;
+
+  for (i = 0; i < HW_WORDS; ++i)
+    if ((set->bits[i] & req->bits[i]) != req->bits[i])
+      return 0;
+
+  return 1;
+}
+
+
+/* gcc arch types */
+
+#define cpu_x86_64            0
+
+/* x86-64 psABI micro-architecture levels */
+#define cpu_x86_64_v2         1
+#define cpu_x86_64_v3         2
+#define cpu_x86_64_v4         3
+#define intel_core2           100
+#define intel_nehalem         101
+#define intel_westmere        102
+#define intel_sandybridge     103
+#define intel_ivybridge       104
+#define intel_haswell         105
+#define intel_broadwell       106
+#define intel_skylake         107
+#define intel_bonnell         108
+#define intel_silvermont      109
+#define intel_goldmont        110
+#define intel_goldmont_plus   111
+#define intel_tremont         112
+#define intel_knl             113
+#define intel_knm             114
+#define intel_skylake_avx512  115
+#define intel_cannonlake      116
+#define intel_icelake_client  117
+#define intel_icelake_server  118
+#define intel_cascadelake     119
+#define intel_cooperlake      120
+#define intel_tigerlake       121
+#define intel_sapphirerapids  122
+#define intel_alderlake       123
+#define intel_sierraforest    124
+#define intel_emeraldrapids   125
+#define intel_graniterapids   126
+#define intel_graniterapids_d 127
+
+#define amd_athlon64          200
+#define amd_athlon64_sse3     201
+#define amd_amdfam10          202
+#define amd_bdver1            203
+#define amd_bdver2            204
+#define amd_bdver3            205
+#define amd_bdver4            206
+#define amd_znver1            207
+#define amd_znver2            208
+#define amd_btver1            209
+#define amd_btver2            210
+#define amd_znver3            211
+#define amd_znver4            212
+#define amd_znver5            213
+
+#define via_eden_x2           300
+#define via_nano              301
+#define via_nano_3000         302
+#define via_eden_x4           303
+#define zhaoxin_lujiazui      310
+#define zhaoxin_yongfeng      311
+
+/* cache descriptions */
+
+#define cache_null        0
+#define cache_data        1
+#define cache_instruction 2
+#define cache_unified     3
+
+#define DCPU_MAX_CACHES   8
+
+typedef struct {
+  int           level;        /* 1, 2, 3, ... */
+  int           type;         /* cache_data, cache_instruction, ... */
+  unsigned long size;         /* in bytes */
+  int           ways;         /* 0 = fully associative, -1 = unknown */
+  int           line_size;    /* in bytes */
+  int           partitions;   /* physical line partitions */
+  int           sets;         /* 0 = unknown */
+  int           inclusive;    /* 1 = inclusive of the lower levels */
+  int           shared;       /* max. logical CPUs sharing, 0 = unknown */
+} _cpu_cache;
+
+
+/* core types of leaf 1Ah, only hybrid CPUs have them */
+
+#define core_type_none 0          /* not hybrid */
+#define core_type_atom 0x20       /* E-core */
+#define core_type_core 0x40       /* P-core */
+#define core_type_any  -1
+
+
+/* topology of one logical CPU */
+
+typedef struct {
+  int          cpu;           /* OS number of the logical CPU */
+  int          valid;         /* 0 if the CPU could not be probed */
+  unsigned int apic_id;       /* (x2)APIC ID */
+  int          smt_id;        /* thread within the core */
+  int          core_id;       /* core within the module */
+  int          module_id;     /* module within the die */
+  int          die_id;        /* die within the package */
+  int          package_id;
+  int          l3_domain;     /* CPUs sharing one L3 (a CCX), 0, 1, ... */
+  int          node;          /* NUMA node, -1 if unknown */
+  int          core_type;     /* core_type_* */
+} _cpu_topology;
+
+
+typedef struct {
+  int packages;
+  int dies;
+  int cores;                  /* physical cores */
+  int threads;                /* logical CPUs */
+  int l3_domains;
+  int nodes;                  /* NUMA nodes, 0 if unknown */
+} _cpu_topology_summary;
+
+
+/* the CPUs a process may use, see dcpu_limits() */
+
+#define cgroup_none 0
+#define cgroup_v1   1
+#define cgroup_v2   2
+
+typedef struct {
+  int    online;              /* online CPUs of the system */
+  int    affinity;            /* CPUs of the affinity mask */
+  int    cpuset;              /* CPUs of the cgroup cpuset, 0 = none */
+  int    cgroup;              /* cgroup_* of the CPU controller */
+  double quota;               /* CFS quota in CPUs, 0.0 = none */
+  int    cores;               /* physical cores of the affinity mask */
+  int    threads;             /* logical CPUs of the affinity mask */
+  int    core_workers;        /* recommended, one worker per core */
+  int    thread_workers;      /* recommended, one worker per thread */
+} _cpu_limits;
+
+
+/* per CPU audit data */
+
+typedef struct {
+  int             cpu;            /* OS number of the logical CPU */
+  int             valid;          /* 0 if the CPU could not be probed */
+  unsigned int    signature;      /* family, model, stepping (EAX=1) */
+  unsigned long   microcode;      /* microcode revision, 0 = unknown */
+  char            brand[49];
+  int             core_type;      /* core_type_* */
+  unsigned int    native_model;   /* native model ID of leaf 1Ah */
+  _cpu_featureset features;       /* as reported by the CPU */
+} _cpu_audit;
+
+
+/* classification of another processor, e.g. from a CPUID dump */
+
+typedef struct {
+  int             cpu_type;       /* CPU_* vendor */
+  unsigned int    signature;      /* family, model, stepping (EAX=1) */
+  uint64_t        xcr0;
+  int             arch;
+  int             level;
+  int             tune;           /* arch of the model, for -mtune */
+  _cpu_featureset features;       /* usable features */
+} _cpu_host;
+
+
+/* the effective features: CPUID merged with the view of the kernel,
+   see dcpu_effective() */
+
+typedef struct {
+  int             cpuid_usable;   /* 0 if CPUID faults */
+  int             cpuinfo;        /* 1 if /proc/cpuinfo was read */
+  unsigned long   hwcap;          /* AT_HWCAP, AT_HWCAP2 */
+  unsigned long   hwcap2;
+  char            vendor[13];     /* only without CPUID, from the kernel */
+  char            brand[49];
+  int             cpu_type;
+  unsigned int    signature;
+  int             arch;
+  int             level;
+  _cpu_featureset features;       /* effective features */
+  _cpu_featureset kernel_disabled;  /* in CPUID, but off in the kernel */
+  _cpu_featureset kernel_only;    /* reported by the kernel, not CPUID */
+} _cpu_effective;
+
+
+/* measured SIMD throughput of one thread, index 0, 1, 2 = 128, 256,
+   512 bit, 0 if the width is not available */
+
+#define DCPU_SIMD_WIDTHS 3
+
+typedef struct {
+  double fma[DCPU_SIMD_WIDTHS];      /* single precision GFLOP/s */
+  double integer[DCPU_SIMD_WIDTHS];  /* 16 bit multiply-add, G op/s */
+  int    prefer_width;               /* for -mprefer-vector-width */
+} _cpu_simd;
+
+
+/* time stamp counter, see dcpu_tsc() */
+
+#define tsc_source_none        0    /* frequency unknown */
+#define tsc_source_cpuid       1    /* leaf 15h, crystal clock ratio */
+#define tsc_source_hypervisor  2    /* leaf 40000010h of KVM, VMware */
+#define tsc_source_calibrated  3    /* measured against the raw clock */
+
+typedef struct {
+  int           invariant;      /* constant rate in all P- and C-states */
+  int           source;         /* tsc_source_* of tsc_hz */
+  uint64_t      tsc_hz;         /* 0 = unknown */
+  double        ns_per_tick;    /* 0.0 = unknown */
+  unsigned long crystal_hz;     /* leaf 15h, 0 = unknown */
+  unsigned int  base_mhz;       /* leaf 16h, 0 = unknown */
+  unsigned int  max_mhz;
+  unsigned int  bus_mhz;
+} _cpu_tsc;
+
+
+/* all detected information of the running CPU */
+
+typedef struct {
+  char            vendor[13];
+  char            brand[49];
+  int             cpu_type;
+  unsigned int    cpuid_level;
+  unsigned int    cpuid_ext_level;
+  unsigned int    signature;      /* family, model, stepping (EAX=1) */
+  int             arch;
+  int             level;
+  int             tune;           /* arch of the model, for -mtune */
+  uint64_t        xcr0;           /* OS enabled register states */
+  int             cpuid_faulting; /* 1 if CPUID is disabled by the kernel */
+  _cpu_featureset features;       /* usable features */
+  _cpu_featureset hw_features;    /* features reported by the hardware */
+  int             ncaches;
+  _cpu_cache      caches[DCPU_MAX_CACHES];
+  int             hypervisor_type;    /* HV_* */
+  char            hypervisor[13];     /* signature of the hypervisor */
+  unsigned int    hypervisor_leaf;    /* first leaf of the hypervisor */
+  unsigned int    hypervisor_level;   /* its maximum leaf */
+  _cpu_featureset masked;         /* implied by the model, not in CPUID */
+  int             amx_tiles;      /* AMX palette 1, 0 without AMX */
+  int             amx_rows;       /* rows per tile */
+  int             amx_bytes_per_row;
+} _cpu_info;
+
+
+/* filled by dcpu_init(), do not access before dcpu_init() was called */
+extern DCPU_API _cpu_info dcpu_cpu;
+extern DCPU_API int       dcpu_initialized;
+
+
+DCPU_API int dcpu_init(void);
+
+DCPU_API const _cpu_info *dcpu_info(void);
+DCPU_API const char *dcpu_arch(void);
+DCPU_API const char *dcpu_level(void);
+DCPU_API const char *dcpu_brand(void);
+DCPU_API const char *dcpu_vendor(void);
+DCPU_API const char *dcpu_arch_name(int arch);
+DCPU_API const char *dcpu_feature_name(int feature);
+DCPU_API int dcpu_arch_id(const char *name);
+DCPU_API const _cpu_cache *dcpu_caches(int *n);
+DCPU_API const _cpu_cache *dcpu_cache(int level, int type);
+DCPU_API int dcpu_topology(_cpu_topology *cpus, int max);
+DCPU_API void dcpu_topology_summary(const _cpu_topology *cpus, int n,
+                                    _cpu_topology_summary *sum,
+                                    int *core_cpus);
+DCPU_API int dcpu_limits(const _cpu_topology *cpus, int n,
+                         _cpu_limits *lim);
+DCPU_API int dcpu_audit(_cpu_audit *cpus, int max);
+DCPU_API void dcpu_audit_common(const _cpu_audit *cpus, int n, int core_type,
+                                _cpu_featureset *set);
+DCPU_API int dcpu_feature_id(const char *name);
+
+
+DCPU_API void dcpu_arch_features(int arch, _cpu_featureset *set);
+DCPU_API int dcpu_arch_parent(int arch);
+DCPU_API int dcpu_gcc_arch(int arch, int gcc);
+DCPU_API int dcpu_supports_arch(int arch);
+DCPU_API int dcpu_arch_ranking(int *archs, int max);
+DCPU_API int dcpu_os_disabled(int feature);
+DCPU_API const char *dcpu_feature_gcc_name(int feature);
+DCPU_API int dcpu_gcc_flags(int arch, const _cpu_featureset *features,
+                            char *buf, int size);
+DCPU_API int dcpu_gcc_flags_for(int arch, const _cpu_featureset *features,
+                                int gcc, char *buf, int size);
+
+
+/* family/model classification: the arch of the model is the one to
+   tune for, even if features are masked and -march has to fall back
+*/
+
+DCPU_API void dcpu_signature(unsigned int signature, unsigned int *family,
+                             unsigned int *model, unsigned int *stepping);
+DCPU_API int dcpu_model_arch(int cpu_type, unsigned int signature);
+DCPU_API const char *dcpu_tune(void);
+
+
+/* virtualization: the hypervisor name ("KVM", "Hyper-V", ...) or NULL
+   on bare metal, and the features the family/model implies but CPUID
+   doesn't report, inside of a guest usually hidden by the CPU model of
+   the hypervisor, on bare metal fused off (e.g. AVX of some Pentiums)
+*/
+
+DCPU_API const char *dcpu_hypervisor(void);
+DCPU_API int dcpu_masked(int feature);
+
+
+/* CPUID dumps: record all leaves of this processor into a file, or
+   replay the detection from such a file (NULL returns to the hardware),
+   the replay must not run concurrently with other library calls
+*/
+
+DCPU_API int dcpu_cpuid_record(const char *filename);
+DCPU_API int dcpu_cpuid_replay(const char *filename);
+
+
+/* classification of other processors, these calls don't change the
+   state of the library and may run in parallel
+*/
+
+DCPU_API int dcpu_cpuid_host(const char *filename, _cpu_host *host);
+DCPU_API int dcpu_vendor_type(const char *vendor);
+DCPU_API int dcpu_classify(int cpu_type, const _cpu_featureset *features);
+DCPU_API int dcpu_classify_level(const _cpu_featureset *features);
+
+
+/* the effective features: only what the kernel allows to run, works
+   also if CPUID faults; dcpu_use_effective() makes them the features
+   of all further queries and must not run concurrently with other
+   library calls */
+DCPU_API int dcpu_effective(_cpu_effective *eff);
+DCPU_API void dcpu_use_effective(const _cpu_effective *eff);
+
+/* calibrates for 10 ms if CPUID gives no TSC frequency, not part of
+   dcpu_init() */
+DCPU_API void dcpu_tsc(_cpu_tsc *tsc);
+DCPU_API void dcpu_tsc_cpuid(_cpu_tsc *tsc);
+
+/* runs SIMD kernels for about half a second, not part of dcpu_init() */
+DCPU_API void dcpu_simd_probe(_cpu_simd *simd);
+
+
+/* dcpu_has
+
+returns 1 if the feature is available, 0 otherwise
+*/
+
+static inline int dcpu_has(int feature)
+{
+  if (__builtin_expect(!__atomic_load_n(&dcpu_initialized, __ATOMIC_ACQUIRE), 0))
+    dcpu_init();
+
+  return (int)featureset_has(&dcpu_cpu.features, feature);
+}
+
+
+/* runtime dispatch
+
+   an implementation is tagged with a gcc arch (all features gcc
+   enables for -march=<arch> are required) and/or an explicit list of
+   required features terminated by HW_END. dcpu_resolve() returns the
+   implementation with the largest requirement set the CPU satisfies,
+   on equal requirements the first one in the list wins. Provide a
+   fallback with cpu_x86_64 and no features.
+
+   dcpu_resolve() neither allocates memory nor calls any libc
+   function, it can be used from a GNU ifunc resolver:
+
+     static const dcpu_impl sum_impls[] = {
+       { (void *)sum_avx2, cpu_x86_64, { HW_AVX2, HW_FMA, HW_END } },
+       { (void *)sum_sse2, cpu_x86_64, { HW_END } } };
+
+     DCPU_IFUNC_RESOLVER(sum, sum_impls)
+     int sum(const int *, int) __attribute__((ifunc("sum_resolver")));
+*/
+
+#define DCPU_MAX_FEATURES 16
+
+typedef struct {
+  void *fn;
+  int   arch;
+  int   features[DCPU_MAX_FEATURES];
+} dcpu_impl;
+
+
+DCPU_API void *dcpu_resolve(const dcpu_impl *impls, int n);
+
+
+/* dcpu_resolve_cached
+
+resolves once and keeps the result in *slot, afterwards it is a
+single load and branch
+*/
+
+static inline void *dcpu_resolve_cached(void **slot, const dcpu_impl *impls,
+                                        int n)
+{
+  void *fn = __atomic_load_n(slot, __ATOMIC_ACQUIRE);
+
+  if (__builtin_expect(fn == NULL, 0))
+  {
+    fn = dcpu_resolve(impls, n);
+    __atomic_store_n(slot, fn, __ATOMIC_RELEASE);
+  }
+
+  return fn;
+}
+
+
+#define DCPU_IFUNC_RESOLVER(name, impls)                                \
+  static void *name##_resolver(void)                                    \
+  {                                                                     \
+    return dcpu_resolve(impls, (int)(sizeof(impls) / sizeof(impls[0]))); \
+  }
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
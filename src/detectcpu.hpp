@@ -0,0 +1,214 @@
+/* detectcpu.hpp
+
+written by: Oliver Cordes 2019-07-01
+changed by: Oliver Cordes 2019-07-01
+
+*/
+
+/* header-only C++ interface of the libdetectcpu library (C++11)
+
+   the features are the HW_* ids of detectcpu.h, which are generated
+   from cpu_features.h like everything else. Passed as template
+   arguments all masks are built at compile time, a feature test is
+   the initialization branch plus a load and a mask per bitset word:
+
+     if (dcpu::has<HW_AVX512BW>())
+       ...
+
+   dcpu::dispatch<Impls...> resolves once with the rules of
+   dcpu_resolve() (the largest satisfied requirement set wins, on
+   equal requirements the first one) and afterwards calls through a
+   cached function pointer:
+
+     struct sum_avx2 : dcpu::impl<cpu_x86_64, HW_AVX2, HW_FMA>
+     { static int run(const int *a, int n); };
+     struct sum_sse2 : dcpu::impl<cpu_x86_64>
+     { static int run(const int *a, int n); };
+
+     int s = dcpu::dispatch<sum_avx2, sum_sse2>::call(a, n);
+*/
+
+#ifndef DETECTCPU_HPP
+#define DETECTCPU_HPP
+
+#include "detectcpu.h"
+
+
+namespace dcpu {
+
+
+/* the leaf/bit specification of a feature, the same table the
+   library decodes */
+
+struct feature_spec {
+  unsigned int leaf;
+  unsigned int subleaf;
+  int          reg;
+  int          bit;
+  const char  *name;
+  const char  *gcc;           /* gcc -m option name, NULL if none */
+  int          gcc_release;   /* first gcc major release with -m<gcc> */
+};
+
+
+namespace detail {
+
+template <typename T = void>
+struct feature_table {
+  static constexpr feature_spec specs[HW_NUM_FEATURES] = {
+#define CPU_FEATURE(id, leaf, subleaf, reg, bit, name, gcc, gccver) \
+    { leaf, subleaf, reg, bit, name, gcc, gccver },
+#include "cpu_features.h"
+#undef CPU_FEATURE
+  };
+};
+
+template <typename T>
+constexpr feature_spec feature_table<T>::specs[HW_NUM_FEATURES];
+
+
+constexpr bool valid(void)
+{
+  return true;
+}
+
+template <typename... T>
+constexpr bool valid(int f, T... rest)
+{
+  return (f >= 0) && (f < HW_NUM_FEATURES) && valid(rest...);
+}
+
+
+/* word_mask
+
+the bits of the features in word w of the bitset
+*/
+
+constexpr uint64_t word_mask(int)
+{
+  return 0;
+}
+
+template <typename... T>
+constexpr uint64_t word_mask(int w, int f, T... rest)
+{
+  return (((f >> 6) == w) ? ((uint64_t)1 << (f & 63)) : 0)
+         | word_mask(w, rest...);
+}
+
+
+inline void ensure_init(void)
+{
+  if (__builtin_expect(!__atomic_load_n(&dcpu_initialized, __ATOMIC_ACQUIRE),
+                       0))
+    dcpu_init();
+}
+
+
+template <int... F>
+inline bool contains(const _cpu_featureset &set)
+{
+  for (int w = 0; w < HW_WORDS; ++w)
+  {
+    const uint64_t m = word_mask(w, F...);
+
+    if ((set.bits[w] & m) != m)
+      return false;
+  }
+
+  return true;
+}
+
+} // namespace detail
+
+
+/* spec
+
+returns the leaf/bit specification of a feature
+*/
+
+template <int F>
+constexpr const feature_spec &spec(void)
+{
+  static_assert(detail::valid(F), "unknown feature id");
+
+  return detail::feature_table<>::specs[F];
+}
+
+
+/* has
+
+returns true if all features are available
+*/
+
+template <int... F>
+inline bool has(void)
+{
+  static_assert(sizeof...(F) > 0, "no feature given");
+  static_assert(detail::valid(F...), "unknown feature id");
+
+  detail::ensure_init();
+
+  return detail::contains<F...>(dcpu_cpu.features);
+}
+
+
+/* impl
+
+base of an implementation of dispatch<>: a gcc arch (cpu_x86_64 for
+none) and the required features
+*/
+
+template <int Arch, int... F>
+struct impl {
+  static_assert(sizeof...(F) < DCPU_MAX_FEATURES, "too many features");
+  static_assert(detail::valid(F...), "unknown feature id");
+
+  static constexpr int arch = Arch;
+
+  static dcpu_impl entry(void *fn)
+  {
+    return dcpu_impl{ fn, Arch, { F..., HW_END } };
+  }
+};
+
+
+/* dispatch
+
+picks the best of the implementations on the first call, all of them
+need a static run() with the signature of the first one
+*/
+
+template <typename First, typename... Rest>
+struct dispatch {
+  typedef decltype(&First::run) function;
+
+  static function resolve(void)
+  {
+    const dcpu_impl impls[] = {
+      First::entry((void *)&First::run),
+      Rest::entry((void *)static_cast<function>(&Rest::run))...
+    };
+
+    return (function)dcpu_resolve(impls,
+                                  (int)(sizeof(impls) / sizeof(impls[0])));
+  }
+
+  static function get(void)
+  {
+    static const function fn = resolve();
+
+    return fn;
+  }
+
+  template <typename... Args>
+  static auto call(Args &&... args)
+    -> decltype(First::run(static_cast<Args &&>(args)...))
+  {
+    return get()(static_cast<Args &&>(args)...);
+  }
+};
+
+} // namespace dcpu
+
+#endif
@@ -0,0 +1,72 @@
+#include "cpu_internal.h"
+
+
+/* dispatch.c
+
+written by: Oliver Cordes 2019-07-01
+changed by: Oliver Cordes 2019-07-01
+
+*/
+
+
+/* the resolver runs inside of GNU ifunc resolvers, before the
+   relocation of the program is finished. No memory allocation, no
+   stdio and no other libc calls are allowed in here!
+*/
+
+
+int featureset_count(const _cpu_featureset *set)
+{
+  int i;
+  int n = 0;
+
+  for (i = 0; i < HW_WORDS; ++i)
+    n += __builtin_popcountll(set->bits[i]);
+
+  return n;
+}
+
+
+/* impl_requirements
+
+collects the arch features and the explicit features of one
+implementation
+*/
+
+void impl_requirements(const dcpu_impl *impl, _cpu_featureset *req)
+{
+  int i;
+
+  get_arch_features(impl->arch, req);
+
+  for (i = 0; (i < DCPU_MAX_FEATURES) && (impl->features[i] != HW_END); ++i)
+    featureset_set(req, impl->features[i]);
+}
+
+
+void *dcpu_resolve(const dcpu_impl *impls, int n)
+{
+  _cpu_featureset req;
+  void           *best = NULL;
+  int             best_rank = -1;
+  int             rank;
+  int             i;
+
+  dcpu_init();
+
+  for (i = 0; i < n; ++i)
+  {
+    impl_requirements(&impls[i], &req);
+    if (!featureset_contains(&dcpu_cpu.features, &req))
+      continue;
+
+    rank = featureset_count(&req);
+    if (rank > best_rank)
+    {
+      best = impls[i].fn;
+      best_rank = rank;
+    }
+  }
+
+  return best;
+}
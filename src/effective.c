@@ -0,0 +1,411 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/auxv.h>
+
+#include "cpu_internal.h"
+
+
+/* effective.c
+
+written by: Oliver Cordes 2019-07-01
+changed by: Oliver Cordes 2019-07-01
+
+*/
+
+
+/* the effective features: what CPUID reports, minus what the kernel
+   turned off (clearcpuid=, tsx=off, nofsgsbase, an old kernel without
+   FSGSBASE support, ...). The kernel view comes from the auxiliary
+   vector (AT_HWCAP = leaf 1 EDX, AT_HWCAP2) and the flags line of
+   /proc/cpuinfo. If CPUID faults, the kernel view is all there is.
+
+   The auxiliary vector is read from /proc/self/auxv: on x86-64 glibc's
+   getauxval(AT_HWCAP) returns glibc's own hwcap bits, not the value of
+   the kernel.
+
+   noxsave needs no extra handling, the kernel doesn't set OSXSAVE then
+   and the XCR0 gates drop the AVX features anyway.
+*/
+
+#define CPUINFO_LINE 8192
+
+/* AT_HWCAP2 bits of x86 */
+#define HWCAP2_FSGSBASE (1UL << 1)
+
+
+/* the features compared with /proc/cpuinfo and the kernel names,
+   a feature missing in the flags of the kernel is off. Features the
+   kernel doesn't print (e.g. osxsave) are not in the list.
+*/
+
+typedef struct {
+  int   id;
+  char *name;
+} _kernel_flag;
+
+
+static _kernel_flag kernel_flags[] = {
+  {HW_FPU, "fpu"},
+  {HW_TSC, "tsc"},
+  {HW_CX8, "cx8"},
+  {HW_CMOV, "cmov"},
+  {HW_CLFLUSH, "clflush"},
+  {HW_MMX, "mmx"},
+  {HW_FXSR, "fxsr"},
+  {HW_SSE, "sse"},
+  {HW_SSE2, "sse2"},
+  {HW_SYSCALL, "syscall"},
+  {HW_NX, "nx"},
+  {HW_RDTSCP, "rdtscp"},
+  {HW_LM, "lm"},
+  {HW_3DNOWEXT, "3dnowext"},
+  {HW_3DNOW, "3dnow"},
+  {HW_SSE3, "pni"},
+  {HW_PCLMUL, "pclmulqdq"},
+  {HW_SSSE3, "ssse3"},
+  {HW_FMA, "fma"},
+  {HW_CX16, "cx16"},
+  {HW_SSE41, "sse4_1"},
+  {HW_SSE42, "sse4_2"},
+  {HW_MOVBE, "movbe"},
+  {HW_POPCNT, "popcnt"},
+  {HW_AES, "aes"},
+  {HW_XSAVE, "xsave"},
+  {HW_AVX, "avx"},
+  {HW_F16C, "f16c"},
+  {HW_RDRND, "rdrand"},
+  {HW_LAHF_LM, "lahf_lm"},
+  {HW_ABM, "abm"},
+  {HW_SSE4A, "sse4a"},
+  {HW_3DNOWPREFETCH, "3dnowprefetch"},
+  {HW_XOP, "xop"},
+  {HW_LWP, "lwp"},
+  {HW_FMA4, "fma4"},
+  {HW_TBM, "tbm"},
+  {HW_MWAITX, "mwaitx"},
+  {HW_SGX, "sgx"},
+  {HW_BMI, "bmi1"},
+  {HW_HLE, "hle"},
+  {HW_AVX2, "avx2"},
+  {HW_BMI2, "bmi2"},
+  {HW_ERMS, "erms"},
+  {HW_RTM, "rtm"},
+  {HW_MPX, "mpx"},
+  {HW_AVX512F, "avx512f"},
+  {HW_AVX512DQ, "avx512dq"},
+  {HW_RDSEED, "rdseed"},
+  {HW_ADX, "adx"},
+  {HW_AVX512IFMA, "avx512ifma"},
+  {HW_CLFLUSHOPT, "clflushopt"},
+  {HW_CLWB, "clwb"},
+  {HW_AVX512PF, "avx512pf"},
+  {HW_AVX512ER, "avx512er"},
+  {HW_AVX512CD, "avx512cd"},
+  {HW_SHA, "sha_ni"},
+  {HW_AVX512BW, "avx512bw"},
+  {HW_AVX512VL, "avx512vl"},
+  {HW_AVX512VBMI, "avx512vbmi"},
+  {HW_PKU, "pku"},
+  {HW_AVX512VBMI2, "avx512_vbmi2"},
+  {HW_GFNI, "gfni"},
+  {HW_VAES, "vaes"},
+  {HW_VPCLMULQDQ, "vpclmulqdq"},
+  {HW_AVX512VNNI, "avx512_vnni"},
+  {HW_AVX512BITALG, "avx512_bitalg"},
+  {HW_AVX512VPOPCNTDQ, "avx512_vpopcntdq"},
+  {HW_RDPID, "rdpid"},
+  {HW_MOVDIRI, "movdiri"},
+  {HW_MOVDIR64B, "movdir64b"},
+  {HW_AVX5124VNNIW, "avx512_4vnniw"},
+  {HW_AVX5124FMAPS, "avx512_4fmaps"},
+  {HW_AVX512VP2INTERSECT, "avx512_vp2intersect"},
+  {HW_SERIALIZE, "serialize"},
+  {HW_AMX_BF16, "amx_bf16"},
+  {HW_AVX512FP16, "avx512_fp16"},
+  {HW_AMX_TILE, "amx_tile"},
+  {HW_AMX_INT8, "amx_int8"},
+  {HW_AVXVNNI, "avx_vnni"},
+  {HW_AVX512BF16, "avx512_bf16"},
+  {HW_CLZERO, "clzero"},
+  {HW_WBNOINVD, "wbnoinvd"},
+  {HW_XSAVEOPT, "xsaveopt"},
+  {HW_XSAVEC, "xsavec"},
+  {HW_XSAVES, "xsaves"},
+  {HW_END, NULL}
+};
+
+
+/* read_cpuinfo
+
+reads the vendor, the signature, the brand and the flags of the
+first processor of /proc/cpuinfo, returns 0 on success
+*/
+
+static int read_cpuinfo(char *vendor, unsigned int *signature, char *brand,
+                        char *flags, size_t size)
+{
+  FILE         *f;
+  char         *line, *value;
+  unsigned int  family = 0, model = 0, stepping = 0;
+  int           found = 0;
+
+  f = fopen("/proc/cpuinfo", "r");
+  if (f == NULL)
+    return -1;
+
+  line = (char *)malloc(CPUINFO_LINE);
+  if (line == NULL)
+  {
+    fclose(f);
+    return -1;
+  }
+
+  flags[0] = '\0';
+  while (fgets(line, CPUINFO_LINE, f) != NULL)
+  {
+    /* only the first processor */
+    if ((line[0] == '\n') && found)
+      break;
+
+    value = strchr(line, ':');
+    if (value == NULL)
+      continue;
+    for (++value; *value == ' '; ++value)
+      ;
+    value[strcspn(value, "\n")] = '\0';
+
+    if (strncmp(line, "vendor_id", 9) == 0)
+      snprintf(vendor, 13, "%s", value);
+    else if (strncmp(line, "cpu family", 10) == 0)
+      family = (unsigned int)strtoul(value, NULL, 10);
+    else if (strncmp(line, "model name", 10) == 0)
+      snprintf(brand, 49, "%s", value);
+    else if (strncmp(line, "model", 5) == 0)
+      model = (unsigned int)strtoul(value, NULL, 10);
+    else if (strncmp(line, "stepping", 8) == 0)
+      stepping = (unsigned int)strtoul(value, NULL, 10);
+    else if (strncmp(line, "flags", 5) == 0)
+    {
+      snprintf(flags, size, " %s ", value);
+      found = 1;
+    }
+  }
+  free(line);
+  fclose(f);
+
+  /* the signature back from the display family and model */
+  *signature = stepping & 0xf;
+  *signature |= (model & 0xf) << 4;
+  *signature |= (model >> 4) << 16;
+  if (family >= 0xf)
+  {
+    *signature |= 0xf << 8;
+    *signature |= (family - 0xf) << 20;
+  }
+  else
+    *signature |= family << 8;
+
+  return found ? 0 : -1;
+}
+
+
+/* read_auxv
+
+reads AT_HWCAP and AT_HWCAP2 of the kernel from /proc/self/auxv,
+returns 0 on success
+*/
+
+static int read_auxv(unsigned long *hwcap, unsigned long *hwcap2)
+{
+  FILE          *f;
+  unsigned long  entry[2];
+  int            found = 0;
+
+  *hwcap = *hwcap2 = 0;
+
+  f = fopen("/proc/self/auxv", "r");
+  if (f == NULL)
+    return -1;
+
+  while (fread(entry, sizeof(entry), 1, f) == 1)
+  {
+    if (entry[0] == AT_NULL)
+      break;
+    if (entry[0] == AT_HWCAP)
+    {
+      *hwcap = entry[1];
+      found = 1;
+    }
+    else if (entry[0] == AT_HWCAP2)
+      *hwcap2 = entry[1];
+  }
+  fclose(f);
+
+  return found ? 0 : -1;
+}
+
+
+static int has_flag(const char *flags, const char *name)
+{
+  char word[64];
+
+  snprintf(word, sizeof(word), " %s ", name);
+
+  return strstr(flags, word) != NULL;
+}
+
+
+/* kernel_view
+
+collects the features the kernel reports: the leaf 1 EDX bits of
+AT_HWCAP (if it holds them), the compared flags of /proc/cpuinfo and FSGSBASE of
+AT_HWCAP2, known marks all features the kernel view covers
+*/
+
+static void kernel_view(const char *flags, int cpuinfo, unsigned long hwcap,
+                        unsigned long hwcap2, _cpu_featureset *kernel,
+                        _cpu_featureset *known)
+{
+  int i;
+
+  featureset_clear(kernel);
+  featureset_clear(known);
+
+  /* no auxv (hwcap 0), every x86-64 has a FPU */
+  if (hwcap & 1)
+    for (i = 0; i < HW_NUM_FEATURES; ++i)
+      if ((cpu_feature_spec[i].leaf == 0x00000001)
+          && (cpu_feature_spec[i].reg == REG_EDX))
+      {
+        featureset_set(known, i);
+        if ((hwcap >> cpu_feature_spec[i].bit) & 1)
+          featureset_set(kernel, i);
+      }
+
+  if (cpuinfo)
+  {
+    for (i = 0; kernel_flags[i].id != HW_END; ++i)
+    {
+      featureset_set(known, kernel_flags[i].id);
+      if (has_flag(flags, kernel_flags[i].name))
+        featureset_set(kernel, kernel_flags[i].id);
+    }
+
+    /* the kernel lists xsave only if it set CR4.OSXSAVE */
+    if (featureset_has(kernel, HW_XSAVE))
+      featureset_set(kernel, HW_OSXSAVE);
+  }
+
+  /* usable in user space only if the kernel enabled it (5.9+) */
+  featureset_set(known, HW_FSGSBASE);
+  if (hwcap2 & HWCAP2_FSGSBASE)
+    featureset_set(kernel, HW_FSGSBASE);
+}
+
+
+/* dcpu_effective
+
+merges the CPUID features with the view of the kernel, returns 0 on
+success and -1 if neither CPUID nor /proc/cpuinfo is available. A
+replayed dump is not merged, the local kernel doesn't belong to it.
+*/
+
+int dcpu_effective(_cpu_effective *eff)
+{
+  _cpu_featureset kernel, known;
+  char           *flags;
+  char            vendor[13] = "";
+  char            brand[49] = "";
+  unsigned int    signature = 0;
+  int             model;
+  int             i;
+
+  dcpu_init();
+
+  memset(eff, 0, sizeof(_cpu_effective));
+  eff->cpuid_usable = !dcpu_cpu.cpuid_faulting;
+  eff->cpu_type = dcpu_cpu.cpu_type;
+  eff->signature = dcpu_cpu.signature;
+  eff->features = dcpu_cpu.features;
+
+  if (!cpuid_replaying())
+  {
+    flags = (char *)malloc(CPUINFO_LINE);
+    if (flags == NULL)
+      return -1;
+    eff->cpuinfo = (read_cpuinfo(vendor, &signature, brand, flags,
+                                 CPUINFO_LINE) == 0);
+    if (read_auxv(&eff->hwcap, &eff->hwcap2) != 0)
+      eff->hwcap2 = getauxval(AT_HWCAP2);
+    kernel_view(flags, eff->cpuinfo, eff->hwcap, eff->hwcap2, &kernel,
+                &known);
+    free(flags);
+
+    if (!eff->cpuid_usable)
+    {
+      if (!eff->cpuinfo)
+        return -1;
+
+      /* the kernel view is all there is */
+      eff->cpu_type = get_cpu_type(vendor);
+      eff->signature = signature;
+      memcpy(eff->vendor, vendor, sizeof(vendor));
+      memcpy(eff->brand, brand, sizeof(brand));
+      eff->kernel_only = kernel;
+      eff->features = kernel;
+    }
+    else
+    {
+      for (i = 0; i < HW_NUM_FEATURES; ++i)
+      {
+        if (!featureset_has(&known, i))
+          continue;
+        if (featureset_has(&dcpu_cpu.features, i)
+            && !featureset_has(&kernel, i))
+        {
+          featureset_set(&eff->kernel_disabled, i);
+          featureset_unset(&eff->features, i);
+        }
+        if (featureset_has(&kernel, i)
+            && !featureset_has(&dcpu_cpu.hw_features, i))
+          featureset_set(&eff->kernel_only, i);
+      }
+    }
+  }
+
+  model = get_model_arch(eff->cpu_type, eff->signature);
+  eff->arch = refine_arch(get_gcc_arch_type(eff->cpu_type, &eff->features),
+                          model, &eff->features);
+  eff->level = get_x86_64_level(&eff->features);
+
+  return 0;
+}
+
+
+/* dcpu_use_effective
+
+makes the effective features the features of all further queries,
+must not run concurrently with other library calls
+*/
+
+void dcpu_use_effective(const _cpu_effective *eff)
+{
+  dcpu_init();
+
+  if (!eff->cpuid_usable)
+  {
+    memcpy(dcpu_cpu.vendor, eff->vendor, sizeof(dcpu_cpu.vendor));
+    memcpy(dcpu_cpu.brand, eff->brand, sizeof(dcpu_cpu.brand));
+    dcpu_cpu.cpu_type = eff->cpu_type;
+    dcpu_cpu.signature = eff->signature;
+    dcpu_cpu.hw_features = eff->features;
+    dcpu_cpu.tune = get_model_arch(eff->cpu_type, eff->signature);
+    if (dcpu_cpu.tune < 0)
+      dcpu_cpu.tune = eff->arch;
+  }
+
+  dcpu_cpu.features = eff->features;
+  dcpu_cpu.arch = eff->arch;
+  dcpu_cpu.level = eff->level;
+}
@@ -0,0 +1,270 @@
+#include "detectcpu.h"
+#include "exports.h"
+
+
+/* exports.c
+
+written by: Oliver Cordes 2019-07-01
+changed by: Oliver Cordes 2019-07-01
+
+*/
+
+
+/* OpenSSL, MKL, OpenBLAS and glibc dispatch on CPUID themselves, in
+   VMs or on unknown SKUs they can pick a code path the CPU (or the
+   kernel) doesn't allow, or a slow generic one. The exports derive
+   all of them from the features of the library:
+
+   OPENSSL_ia32cap          the ~mask form clears the CPUID bits of
+                            leaf 1 and leaf 7 which are not usable
+   MKL_ENABLE_INSTRUCTIONS  the highest instruction set MKL may use
+   OPENBLAS_CORETYPE        the kernel set of a DYNAMIC_ARCH build
+   GLIBC_TUNABLES           glibc.cpu.hwcaps switches off the unusable
+                            features, the non-temporal threshold is a
+                            quarter of the L3 (the glibc 2.38 rule),
+                            appended to the tunables already set
+*/
+
+
+typedef struct {
+  unsigned int leaf;
+  unsigned int subleaf;
+  int          reg;
+  int          bit;
+} _export_bit;
+
+
+static const _export_bit export_bits[HW_NUM_FEATURES] = {
+#define CPU_FEATURE(id, leaf, subleaf, reg, bit, name, gcc, gccver) \
+  { leaf, subleaf, reg, bit },
+#include "cpu_features.h"
+#undef CPU_FEATURE
+};
+
+
+typedef struct {
+  int   id;
+  char *name;
+} _export_name;
+
+
+/* the feature names glibc.cpu.hwcaps accepts */
+
+static const _export_name glibc_hwcaps[] = {
+  {HW_SSSE3, "SSSE3"},
+  {HW_SSE41, "SSE4_1"},
+  {HW_SSE42, "SSE4_2"},
+  {HW_POPCNT, "POPCNT"},
+  {HW_MOVBE, "MOVBE"},
+  {HW_ABM, "LZCNT"},
+  {HW_XSAVE, "XSAVE"},
+  {HW_XSAVEC, "XSAVEC"},
+  {HW_AVX, "AVX"},
+  {HW_FMA, "FMA"},
+  {HW_FMA4, "FMA4"},
+  {HW_AVX2, "AVX2"},
+  {HW_BMI, "BMI1"},
+  {HW_BMI2, "BMI2"},
+  {HW_ERMS, "ERMS"},
+  {HW_FSRM, "FSRM"},
+  {HW_RTM, "RTM"},
+  {HW_AVX512F, "AVX512F"},
+  {HW_AVX512CD, "AVX512CD"},
+  {HW_AVX512BW, "AVX512BW"},
+  {HW_AVX512DQ, "AVX512DQ"},
+  {HW_AVX512VL, "AVX512VL"},
+  {HW_AVX512ER, "AVX512ER"},
+  {HW_AVX512PF, "AVX512PF"},
+  {HW_END, NULL}
+};
+
+
+static const int skx_features[] = {
+  HW_AVX512F, HW_AVX512CD, HW_AVX512BW, HW_AVX512DQ, HW_AVX512VL, HW_END
+};
+
+static const int icx_features[] = {
+  HW_AVX512VBMI, HW_AVX512IFMA, HW_AVX512VBMI2, HW_AVX512BITALG,
+  HW_AVX512VPOPCNTDQ, HW_VAES, HW_GFNI, HW_VPCLMULQDQ, HW_END
+};
+
+static const int spr_features[] = {
+  HW_AVX512FP16, HW_AMX_TILE, HW_AMX_INT8, HW_AMX_BF16, HW_END
+};
+
+
+static int has_all(const int *features)
+{
+  for (; *features != HW_END; ++features)
+    if (!dcpu_has(*features))
+      return 0;
+
+  return 1;
+}
+
+
+/* disabled
+
+returns 1 if CPUID reports the feature, but it is not usable
+*/
+
+static int disabled(int feature)
+{
+  return featureset_has(&dcpu_info()->hw_features, feature)
+         && !dcpu_has(feature);
+}
+
+
+/* openssl_mask
+
+collects the bits of the unusable features of two CPUID registers,
+the first one in the low 32 bits
+*/
+
+static unsigned long long openssl_mask(unsigned int leaf, int low, int high)
+{
+  unsigned long long mask = 0;
+  int                i;
+
+  for (i = 0; i < HW_NUM_FEATURES; ++i)
+  {
+    if ((export_bits[i].leaf != leaf) || (export_bits[i].subleaf != 0)
+        || !disabled(i))
+      continue;
+    if (export_bits[i].reg == low)
+      mask |= 1ULL << export_bits[i].bit;
+    else if (export_bits[i].reg == high)
+      mask |= 1ULL << (export_bits[i].bit + 32);
+  }
+
+  return mask;
+}
+
+
+static const char *mkl_instructions(void)
+{
+  if (has_all(skx_features))
+  {
+    if (!dcpu_has(HW_AVX512VNNI))
+      return "AVX512";
+    if (!has_all(icx_features))
+      return "AVX512_E1";
+    if (!dcpu_has(HW_AVX512BF16))
+      return "AVX512_E2";
+    if (!has_all(spr_features))
+      return "AVX512_E3";
+    return "AVX512_E4";
+  }
+  if (dcpu_has(HW_AVX2) && dcpu_has(HW_FMA))
+    return dcpu_has(HW_AVXVNNI) ? "AVX2_E1" : "AVX2";
+  if (dcpu_has(HW_AVX))
+    return "AVX";
+  if (dcpu_has(HW_SSE42))
+    return "SSE4_2";
+
+  return NULL;
+}
+
+
+static const char *openblas_coretype(void)
+{
+  int amd = (dcpu_cpu.cpu_type == CPU_AMD) || (dcpu_cpu.cpu_type == CPU_Hygon);
+
+  if (has_all(skx_features))
+  {
+    if (dcpu_has(HW_AVX512BF16) && dcpu_has(HW_AVX512FP16))
+      return "SapphireRapids";
+    if (dcpu_has(HW_AVX512BF16))
+      return "Cooperlake";
+    return "SkylakeX";
+  }
+  switch (dcpu_cpu.arch)
+  {
+    case amd_bdver1:
+      return "Bulldozer";
+    case amd_bdver2:
+      return "Piledriver";
+    case amd_bdver3:
+      return "Steamroller";
+    case amd_bdver4:
+      return "Excavator";
+  }
+  if (dcpu_has(HW_AVX2) && dcpu_has(HW_FMA))
+    return amd ? "Zen" : "Haswell";
+  if (dcpu_has(HW_AVX))
+    return "Sandybridge";
+  if (dcpu_has(HW_SSE42))
+    return "Nehalem";
+  if (dcpu_has(HW_SSSE3))
+    return "Core2";
+
+  return "Prescott";
+}
+
+
+static void writer_glibc_tunables(_writer *w)
+{
+  const _cpu_cache *l3;
+  int               i, n = 0;
+
+  l3 = dcpu_cache(3, cache_unified);
+  if ((l3 != NULL) && (l3->size == 0))
+    l3 = NULL;
+  for (i = 0; glibc_hwcaps[i].id != HW_END; ++i)
+    n += disabled(glibc_hwcaps[i].id);
+  if ((n == 0) && (l3 == NULL))
+    return;
+
+  /* on top of the tunables the environment already has */
+  writer_str(w, "export GLIBC_TUNABLES=\"${GLIBC_TUNABLES:+$GLIBC_TUNABLES:}");
+  if (n > 0)
+  {
+    writer_str(w, "glibc.cpu.hwcaps=");
+    for (i = 0, n = 0; glibc_hwcaps[i].id != HW_END; ++i)
+    {
+      if (!disabled(glibc_hwcaps[i].id))
+        continue;
+      writer_str(w, (n++ == 0) ? "-" : ",-");
+      writer_str(w, glibc_hwcaps[i].name);
+    }
+    if (l3 != NULL)
+      writer_char(w, ':');
+  }
+  if (l3 != NULL)
+  {
+    writer_str(w, "glibc.cpu.x86_non_temporal_threshold=");
+    writer_uint(w, l3->size / 4);
+  }
+  writer_str(w, "\"\n");
+}
+
+
+/* writer_library_exports
+
+writes the exports of OpenSSL, MKL, OpenBLAS and glibc
+*/
+
+void writer_library_exports(_writer *w)
+{
+  const char *name;
+
+  writer_str(w, "export OPENSSL_ia32cap='~");
+  writer_hex(w, openssl_mask(0x00000001, REG_EDX, REG_ECX));
+  writer_str(w, ":~");
+  writer_hex(w, openssl_mask(0x00000007, REG_EBX, REG_ECX));
+  writer_str(w, "'\n");
+
+  name = mkl_instructions();
+  if (name != NULL)
+  {
+    writer_str(w, "export MKL_ENABLE_INSTRUCTIONS=");
+    writer_str(w, name);
+    writer_char(w, '\n');
+  }
+
+  writer_str(w, "export OPENBLAS_CORETYPE=");
+  writer_str(w, openblas_coretype());
+  writer_char(w, '\n');
+
+  writer_glibc_tunables(w);
+}
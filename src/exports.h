@@ -0,0 +1,19 @@
+/* exports.h
+
+written by: Oliver Cordes 2019-07-01
+changed by: Oliver Cordes 2019-07-01
+
+*/
+
+/* shell exports which make the libraries with their own CPU dispatch
+   (OpenSSL, MKL, OpenBLAS, glibc) agree with the detected features
+*/
+
+#ifndef EXPORTS_H
+#define EXPORTS_H
+
+#include "writer.h"
+
+void writer_library_exports(_writer *w);
+
+#endif
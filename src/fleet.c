@@ -0,0 +1,458 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <pthread.h>
+
+#include "detectcpu.h"
+#include "fleet.h"
+
+
+/* fleet.c
+
+written by: Oliver Cordes 2019-07-01
+changed by: Oliver Cordes 2019-07-01
+
+*/
+
+
+#define FLEET_MAX_THREADS 64
+#define FLEET_MAX_VENDORS 32
+
+typedef struct {
+  char      *name;
+  char      *path;
+  int        valid;
+  _cpu_host  host;
+} _fleet_host;
+
+typedef struct {
+  _fleet_host *hosts;
+  int          n;
+  int          first;
+  int          step;
+} _fleet_job;
+
+
+static int has_suffix(const char *s, const char *suffix)
+{
+  size_t ls = strlen(s);
+  size_t lx = strlen(suffix);
+
+  return (ls > lx) && (strcmp(s + ls - lx, suffix) == 0);
+}
+
+
+/* json_string_value
+
+copies the string value of "key" of a detect-cpu --json report
+*/
+
+static int json_string_value(const char *json, const char *key, char *value,
+                             size_t size)
+{
+  const char *p = strstr(json, key);
+  size_t      i = 0;
+
+  if (p == NULL)
+    return -1;
+  p = strchr(p + strlen(key), '"');
+  if (p == NULL)
+    return -1;
+
+  for (++p; (*p != '\0') && (*p != '"') && (i + 1 < size); ++p)
+    value[i++] = *p;
+  value[i] = '\0';
+
+  return 0;
+}
+
+
+/* load_json
+
+reads the vendor and the usable features of a detect-cpu --json
+report and classifies them
+*/
+
+static int load_json(const char *path, _cpu_host *host)
+{
+  FILE       *f;
+  char       *json;
+  const char *p, *end;
+  char        name[64];
+  char        vendor[13];
+  long        size;
+  size_t      i;
+  int         id;
+
+  f = fopen(path, "r");
+  if (f == NULL)
+    return -1;
+  fseek(f, 0, SEEK_END);
+  size = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  json = (size > 0) ? (char *)malloc(size + 1) : NULL;
+  if ((json == NULL) || (fread(json, 1, size, f) != (size_t)size))
+  {
+    fclose(f);
+    free(json);
+    return -1;
+  }
+  fclose(f);
+  json[size] = '\0';
+
+  memset(host, 0, sizeof(_cpu_host));
+  if ((p = strstr(json, "\"signature\":")) != NULL)
+    host->signature = (unsigned int)strtoul(p + 12, NULL, 10);
+
+  p = strstr(json, "\"features\":");
+  if ((json_string_value(json, "\"vendor\":", vendor, sizeof(vendor)) != 0)
+      || (p == NULL) || ((end = strchr(p, ']')) == NULL)
+      || ((p = strchr(p, '[')) == NULL))
+  {
+    free(json);
+    return -1;
+  }
+  host->cpu_type = dcpu_vendor_type(vendor);
+
+  while (((p = strchr(p + 1, '"')) != NULL) && (p < end))
+  {
+    for (++p, i = 0; (*p != '"') && (i + 1 < sizeof(name)); ++p)
+      name[i++] = *p;
+    name[i] = '\0';
+    while ((*p != '"') && (*p != '\0'))
+      ++p;
+    if ((id = dcpu_feature_id(name)) >= 0)
+      featureset_set(&host->features, id);
+  }
+  free(json);
+
+  host->arch = dcpu_classify(host->cpu_type, &host->features);
+  host->level = dcpu_classify_level(&host->features);
+  host->tune = dcpu_model_arch(host->cpu_type, host->signature);
+  if (host->tune < 0)
+    host->tune = host->arch;
+
+  return 0;
+}
+
+
+static void *load_hosts(void *arg)
+{
+  _fleet_job  *job = (_fleet_job *)arg;
+  _fleet_host *h;
+  int          i;
+
+  for (i = job->first; i < job->n; i += job->step)
+  {
+    h = &job->hosts[i];
+    if (has_suffix(h->path, ".json"))
+      h->valid = (load_json(h->path, &h->host) == 0);
+    else
+      h->valid = (dcpu_cpuid_host(h->path, &h->host) == 0);
+  }
+
+  return NULL;
+}
+
+
+/* load_fleet
+
+classifies all hosts, the files are spread over one thread per
+online CPU
+*/
+
+static void load_fleet(_fleet_host *hosts, int n)
+{
+  pthread_t  threads[FLEET_MAX_THREADS];
+  int        started[FLEET_MAX_THREADS];
+  _fleet_job jobs[FLEET_MAX_THREADS];
+  long       nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+  int        i;
+
+  if (nthreads > FLEET_MAX_THREADS)
+    nthreads = FLEET_MAX_THREADS;
+  if (nthreads > n)
+    nthreads = n;
+  if (nthreads < 1)
+    nthreads = 1;
+
+  for (i = 0; i < nthreads; ++i)
+  {
+    jobs[i].hosts = hosts;
+    jobs[i].n = n;
+    jobs[i].first = i;
+    jobs[i].step = (int)nthreads;
+    started[i] = (i > 0)
+      && (pthread_create(&threads[i], NULL, load_hosts, &jobs[i]) == 0);
+  }
+
+  /* the own share and the shares of threads which failed to start */
+  for (i = 0; i < nthreads; ++i)
+    if (!started[i])
+      load_hosts(&jobs[i]);
+
+  for (i = 1; i < nthreads; ++i)
+    if (started[i])
+      pthread_join(threads[i], NULL);
+}
+
+
+static int name_compare(const void *a, const void *b)
+{
+  return strcmp(((const _fleet_host *)a)->name,
+                ((const _fleet_host *)b)->name);
+}
+
+
+/* read_fleet_dir
+
+collects the *.cpuid and *.json files of a directory, sorted by
+name, returns the number of files or -1
+*/
+
+static int read_fleet_dir(const char *dir, _fleet_host **hosts)
+{
+  DIR           *d;
+  struct dirent *e;
+  _fleet_host   *h = NULL, *tmp;
+  int            n = 0, max = 0;
+  size_t         len;
+
+  d = opendir(dir);
+  if (d == NULL)
+    return -1;
+
+  while ((e = readdir(d)) != NULL)
+  {
+    if ((e->d_name[0] == '.')
+        || (!has_suffix(e->d_name, ".cpuid") && !has_suffix(e->d_name, ".json")))
+      continue;
+
+    if (n == max)
+    {
+      max = (max == 0) ? 64 : 2 * max;
+      tmp = (_fleet_host *)realloc(h, max * sizeof(_fleet_host));
+      if (tmp == NULL)
+        break;
+      h = tmp;
+    }
+
+    len = strlen(dir) + strlen(e->d_name) + 2;
+    h[n].path = (char *)malloc(len);
+    if (h[n].path == NULL)
+      break;
+    snprintf(h[n].path, len, "%s/%s", dir, e->d_name);
+    h[n].name = h[n].path + strlen(dir) + 1;
+    h[n].valid = 0;
+    ++n;
+  }
+  closedir(d);
+
+  if (n > 0)
+    qsort(h, n, sizeof(_fleet_host), name_compare);
+
+  *hosts = h;
+
+  return n;
+}
+
+
+/* fleet_vendor
+
+returns the vendor, if all hosts have the same vendor, otherwise
+CPU_UNKNOWN; one host of the vendor skip is left out
+*/
+
+static int fleet_vendor(const int *vendors, int skip)
+{
+  int t, n;
+  int found = CPU_UNKNOWN;
+
+  for (t = 0; t < FLEET_MAX_VENDORS; ++t)
+  {
+    n = vendors[t] - (t == skip);
+    if (n == 0)
+      continue;
+    if ((t == CPU_UNKNOWN) || (found != CPU_UNKNOWN))
+      return CPU_UNKNOWN;
+    found = t;
+  }
+
+  return found;
+}
+
+
+static int vendor_index(int cpu_type)
+{
+  return ((cpu_type < 0) || (cpu_type >= FLEET_MAX_VENDORS))
+    ? CPU_UNKNOWN : cpu_type;
+}
+
+
+/* common_target
+
+the best arch all hosts of a feature intersection can run, for
+mixed vendors only the x86-64 level is common
+*/
+
+static void common_target(const _cpu_featureset *common, int cpu_type,
+                          int *arch, int *level)
+{
+  *level = dcpu_classify_level(common);
+  if (cpu_type == CPU_UNKNOWN)
+    *arch = *level;
+  else
+    *arch = dcpu_classify(cpu_type, common);
+}
+
+
+static void print_features(const _cpu_featureset *set)
+{
+  int i;
+
+  for (i = 0; i < HW_NUM_FEATURES; ++i)
+    if (featureset_has(set, i))
+      printf(" %s", dcpu_feature_name(i));
+  printf("\n");
+}
+
+
+/* print_limit
+
+a host limits the fleet, if the fleet without it has a better
+target, the report lists the features the host lacks for it
+*/
+
+static int print_limit(const _fleet_host *h, const _cpu_featureset *without,
+                       int cpu_type, int arch, int level)
+{
+  _cpu_featureset req, level_req;
+  int             w_arch, w_level, i;
+  uint64_t        lacks = 0;
+
+  common_target(without, cpu_type, &w_arch, &w_level);
+  if ((w_arch == arch) && (w_level == level))
+    return 0;
+
+  dcpu_arch_features(w_arch, &req);
+  dcpu_arch_features(w_level, &level_req);
+  for (i = 0; i < HW_WORDS; ++i)
+  {
+    req.bits[i] = (req.bits[i] | level_req.bits[i])
+      & ~h->host.features.bits[i];
+    lacks |= req.bits[i];
+  }
+
+  printf("  %-20s %-16s %-10s -> %s/%s", h->name,
+         dcpu_arch_name(h->host.arch), dcpu_arch_name(h->host.level),
+         dcpu_arch_name(w_arch), dcpu_arch_name(w_level));
+  if (lacks == 0)
+    printf(", other vendor\n");
+  else
+  {
+    printf(", lacks");
+    print_features(&req);
+  }
+
+  return 1;
+}
+
+
+int report_fleet(const char *dir)
+{
+  _fleet_host     *hosts = NULL;
+  _cpu_featureset *prefix, *suffix;
+  int              vendors[FLEET_MAX_VENDORS];
+  int              n, nvalid, i, w, t;
+  int              arch, level, limits = 0;
+
+  n = read_fleet_dir(dir, &hosts);
+  if (n < 0)
+  {
+    fprintf(stderr, "Cannot read the directory '%s'!\n", dir);
+    return 2;
+  }
+
+  load_fleet(hosts, n);
+
+  /* drop the unreadable hosts */
+  for (i = 0, nvalid = 0; i < n; ++i)
+  {
+    if (!hosts[i].valid)
+    {
+      fprintf(stderr, "Cannot read '%s'!\n", hosts[i].path);
+      free(hosts[i].path);
+      continue;
+    }
+    hosts[nvalid++] = hosts[i];
+  }
+
+  if (nvalid == 0)
+  {
+    fprintf(stderr, "No hosts in '%s'!\n", dir);
+    free(hosts);
+    return 2;
+  }
+
+  /* prefix[i] is the intersection of the hosts before i, suffix[i]
+     of the hosts from i on, together they give the fleet without
+     any single host in O(n) */
+  prefix = (_cpu_featureset *)malloc((nvalid + 1) * sizeof(_cpu_featureset));
+  suffix = (_cpu_featureset *)malloc((nvalid + 1) * sizeof(_cpu_featureset));
+  if ((prefix == NULL) || (suffix == NULL))
+  {
+    fprintf(stderr, "Out of memory!\n");
+    free(prefix);
+    free(suffix);
+    return 2;
+  }
+
+  for (w = 0; w < HW_WORDS; ++w)
+    prefix[0].bits[w] = suffix[nvalid].bits[w] = ~(uint64_t)0;
+  for (i = 0; i < nvalid; ++i)
+    for (w = 0; w < HW_WORDS; ++w)
+      prefix[i + 1].bits[w] = prefix[i].bits[w]
+        & hosts[i].host.features.bits[w];
+  for (i = nvalid - 1; i >= 0; --i)
+    for (w = 0; w < HW_WORDS; ++w)
+      suffix[i].bits[w] = suffix[i + 1].bits[w]
+        & hosts[i].host.features.bits[w];
+
+  memset(vendors, 0, sizeof(vendors));
+  for (i = 0; i < nvalid; ++i)
+    ++vendors[vendor_index(hosts[i].host.cpu_type)];
+
+  common_target(&prefix[nvalid], fleet_vendor(vendors, -1), &arch, &level);
+
+  printf("Hosts          : %d\n", nvalid);
+  printf("Common arch    : %s\n", dcpu_arch_name(arch));
+  printf("Common level   : %s\n", dcpu_arch_name(level));
+  printf("Common flags   :");
+  print_features(&prefix[nvalid]);
+
+  if (nvalid > 1)
+  {
+    printf("Limiting hosts :\n");
+    for (i = 0; i < nvalid; ++i)
+    {
+      _cpu_featureset without;
+
+      for (w = 0; w < HW_WORDS; ++w)
+        without.bits[w] = prefix[i].bits[w] & suffix[i + 1].bits[w];
+      t = fleet_vendor(vendors, vendor_index(hosts[i].host.cpu_type));
+      limits += print_limit(&hosts[i], &without, t, arch, level);
+    }
+    if (limits == 0)
+      printf("  none, no single host lowers the target\n");
+  }
+
+  for (i = 0; i < nvalid; ++i)
+    free(hosts[i].path);
+  free(hosts);
+  free(prefix);
+  free(suffix);
+
+  return 0;
+}
@@ -0,0 +1,17 @@
+/* fleet.h
+
+written by: Oliver Cordes 2019-07-01
+changed by: Oliver Cordes 2019-07-01
+
+*/
+
+/* the common build target of many hosts, read from a directory of
+   CPUID dumps (*.cpuid) and detect-cpu --json reports (*.json)
+*/
+
+#ifndef FLEET_H
+#define FLEET_H
+
+int report_fleet(const char *dir);
+
+#endif
@@ -0,0 +1,134 @@
+#include "cpu_internal.h"
+
+
+/* gccflags.c
+
+written by: Oliver Cordes 2019-07-01
+changed by: Oliver Cordes 2019-07-01
+
+*/
+
+
+/* flags_append
+
+appends a string at position pos of buf, returns the new position
+or -1 if buf is too small; a -1 is passed through
+*/
+
+static int flags_append(char *buf, int size, int pos, const char *s)
+{
+  if (pos < 0)
+    return -1;
+
+  while (*s != '\0')
+  {
+    if (pos + 1 >= size)
+      return -1;
+    buf[pos++] = *s++;
+  }
+  buf[pos] = '\0';
+
+  return pos;
+}
+
+
+static int flags_option(char *buf, int size, int pos, const char *prefix,
+                        const char *name)
+{
+  if (pos > 0)
+    pos = flags_append(buf, size, pos, " ");
+  pos = flags_append(buf, size, pos, prefix);
+  return flags_append(buf, size, pos, name);
+}
+
+
+/* gcc_knows
+
+returns 1 if the feature has a gcc option and a gcc of the major
+release gcc knows it, 0 means any gcc
+*/
+
+static int gcc_knows(int feature, int gcc)
+{
+  if (cpu_feature_spec[feature].gcc == NULL)
+    return 0;
+
+  return (gcc <= 0) || (cpu_feature_spec[feature].gcc_release <= gcc);
+}
+
+
+/* dcpu_gcc_flags_for
+
+writes the gcc options which describe the feature set exactly:
+-march=<arch> followed by -mno-<x> for every feature the arch
+enables but the feature set lacks (e.g. AVX disabled by the OS or
+a hypervisor) and -m<x> for every feature beyond the arch.
+Features without a gcc option are ignored. For a gcc major release
+gcc the arch is lowered to one this gcc knows (dcpu_gcc_arch()) and
+the options it doesn't know are left out, 0 means any gcc: features
+which only some releases enable for the arch (AES of westmere) get a
+-mno-<x> if absent and a -m<x> if present. Returns the length of the
+string or -1 if buf is too small.
+*/
+
+int dcpu_gcc_flags_for(int arch, const _cpu_featureset *features, int gcc,
+                       char *buf, int size)
+{
+  _cpu_featureset implied, maybe;
+  const char     *name;
+  int             pos = 0;
+  int             i;
+
+  if ((buf == NULL) || (size < 1))
+    return -1;
+  buf[0] = '\0';
+
+  arch = dcpu_gcc_arch(arch, gcc);
+  name = get_arch_name(arch);
+  if (name == NULL)
+    return -1;
+
+  /* any gcc: implied by the newest release, maybe by the first one
+     knowing the arch */
+  get_arch_features_for(arch, gcc, &implied);
+  if (gcc > 0)
+    maybe = implied;
+  else
+    get_arch_features_for(arch, get_arch_gcc(arch), &maybe);
+
+  pos = flags_option(buf, size, pos, "-march=", name);
+
+  for (i = 0; i < HW_NUM_FEATURES; ++i)
+  {
+    if (!gcc_knows(i, gcc))
+      continue;
+    if (featureset_has(&maybe, i) && !featureset_has(features, i))
+      pos = flags_option(buf, size, pos, "-mno-", cpu_feature_spec[i].gcc);
+  }
+
+  for (i = 0; i < HW_NUM_FEATURES; ++i)
+  {
+    if (!gcc_knows(i, gcc))
+      continue;
+    if (!featureset_has(&implied, i) && featureset_has(features, i))
+      pos = flags_option(buf, size, pos, "-m", cpu_feature_spec[i].gcc);
+  }
+
+  return pos;
+}
+
+
+int dcpu_gcc_flags(int arch, const _cpu_featureset *features, char *buf,
+                   int size)
+{
+  return dcpu_gcc_flags_for(arch, features, 0, buf, size);
+}
+
+
+const char *dcpu_feature_gcc_name(int feature)
+{
+  if ((feature < 0) || (feature >= HW_NUM_FEATURES))
+    return NULL;
+
+  return cpu_feature_spec[feature].gcc;
+}
@@ -0,0 +1,92 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+
+#include "detectcpu.h"
+#include "launch.h"
+
+
+/* launch.c
+
+written by: Oliver Cordes 2019-07-01
+changed by: Oliver Cordes 2019-07-01
+
+*/
+
+
+/* the builds are named <base>.<gcc arch> or <base>.<x86-64 level>,
+   e.g. app.sapphirerapids, app.x86-64-v3, app.x86-64. The candidates
+   in the order of preference:
+
+   - the gcc archs of dcpu_arch_ranking(): the detected arch, its
+     parent archs and all other archs whose features the CPU has,
+     the largest feature set first
+   - the x86-64 levels from the detected one down to x86-64
+
+   only access() and execv() touch the file system, so the launcher
+   costs the detection and a few system calls
+*/
+
+#define LAUNCH_MAX_ARCHS 128
+
+
+/* try_exec
+
+executes <base>.<arch name> if it exists, returns only if not or if
+execv() fails
+*/
+
+static void try_exec(const char *base, int arch, char *const args[])
+{
+  char   path[PATH_MAX];
+  char **argv;
+  int    n;
+
+  if (snprintf(path, sizeof(path), "%s.%s", base, dcpu_arch_name(arch))
+      >= (int)sizeof(path))
+    return;
+  if (access(path, X_OK) != 0)
+    return;
+
+  for (n = 0; args[n] != NULL; ++n)
+    ;
+  argv = (char **)malloc((n + 2) * sizeof(char *));
+  if (argv == NULL)
+  {
+    fprintf(stderr, "Cannot execute '%s': %s\n", path, strerror(ENOMEM));
+    return;
+  }
+  argv[0] = path;
+  memcpy(argv + 1, args, (n + 1) * sizeof(char *));
+
+  execv(path, argv);
+  fprintf(stderr, "Cannot execute '%s': %s\n", path, strerror(errno));
+  free(argv);
+}
+
+
+/* exec_best
+
+executes the best build of base with the arguments args, returns
+127 if there is none
+*/
+
+int exec_best(const char *base, char *const args[])
+{
+  int archs[LAUNCH_MAX_ARCHS];
+  int n, i, level;
+
+  n = dcpu_arch_ranking(archs, LAUNCH_MAX_ARCHS);
+  for (i = 0; i < n; ++i)
+    try_exec(base, archs[i], args);
+
+  for (level = dcpu_cpu.level; level >= cpu_x86_64; --level)
+    try_exec(base, level, args);
+
+  fprintf(stderr, "No build of '%s' for this CPU!\n", base);
+
+  return 127;
+}
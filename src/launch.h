@@ -0,0 +1,17 @@
+/* launch.h
+
+written by: Oliver Cordes 2019-07-01
+changed by: Oliver Cordes 2019-07-01
+
+*/
+
+/* the launcher of fat images: one build per arch or level next to
+   each other, the best one the CPU can run is executed
+*/
+
+#ifndef LAUNCH_H
+#define LAUNCH_H
+
+int exec_best(const char *base, char *const args[]);
+
+#endif
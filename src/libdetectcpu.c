@@ -0,0 +1,1535 @@
+#include "cpu_internal.h"
+
+
+/* libdetectcpu.c
+
+written by: Oliver Cordes 2019-07-01
+changed by: Oliver Cordes 2019-07-01
+
+*/
+
+
+/* this code is heavily inspired by
+  https://github.com/Mysticial/FeatureDetector
+*/
+
+/* technical information about the cpuid and feature
+  extraction one can get from:
+
+  https://dox.ipxe.org/cpuid_8h_source.html
+  https://hjlebbink.github.io/x86doc/html/CPUID.html
+*/
+
+/* tranlating the CPU features into gcc ARCH definitions
+  based on this document:
+
+  https://gcc.gnu.org/onlinedocs/gcc/x86-Options.html
+
+*/
+
+/* the cpuid calls and the replay of dumps are in cpuidsrc.c */
+
+
+_cpu_info dcpu_cpu;
+int       dcpu_initialized = 0;
+
+
+typedef struct {
+  int id;
+  char *vendor;
+} _vendor_strings;
+
+
+_cpu_feature cpu_feature_spec[HW_NUM_FEATURES] = {
+#define CPU_FEATURE(id, leaf, subleaf, reg, bit, name, gcc, gccver) \
+  { leaf, subleaf, reg, bit, name, gcc, gccver },
+#include "cpu_features.h"
+#undef CPU_FEATURE
+};
+
+
+/* the classifiers test the feature set passed in as features */
+#define cpu_has(f) featureset_has(features, f)
+
+
+/* gcc arch types
+
+   every arch lists the ISA features gcc enables for -march=<arch>
+   in addition to the features of its parent arch (see PTA_* in
+   gcc/config/i386/i386.h), the list is terminated by HW_END
+*/
+
+#define ARCH_MAX_FEATURES 32
+
+typedef struct {
+  int id;
+  char *arch;
+  int parent;
+  int gcc;            /* first gcc major release knowing -march=arch */
+  int features[ARCH_MAX_FEATURES];
+} _cpu_arch;
+
+
+/* x86-64 baseline */
+int x86_64_features[] = { HW_FPU, HW_CX8, HW_CMOV, HW_MMX, HW_FXSR,
+                          HW_SSE, HW_SSE2, HW_SYSCALL, HW_LM, HW_END };
+
+
+_cpu_arch cpu_archs[] = {
+  {cpu_x86_64_v2, "x86-64-v2", cpu_x86_64, 11,
+    {HW_CX16, HW_LAHF_LM, HW_POPCNT, HW_SSE3, HW_SSE41, HW_SSE42,
+     HW_SSSE3, HW_END}},
+  {cpu_x86_64_v3, "x86-64-v3", cpu_x86_64_v2, 11,
+    {HW_AVX, HW_AVX2, HW_BMI, HW_BMI2, HW_F16C, HW_FMA, HW_ABM, HW_MOVBE,
+     HW_XSAVE, HW_OSXSAVE, HW_END}},
+  {cpu_x86_64_v4, "x86-64-v4", cpu_x86_64_v3, 11,
+    {HW_AVX512F, HW_AVX512BW, HW_AVX512CD, HW_AVX512DQ, HW_AVX512VL,
+     HW_END}},
+  {intel_core2, "core2", cpu_x86_64, 4,
+    {HW_SSE3, HW_SSSE3, HW_CX16, HW_LAHF_LM, HW_END}},
+  {intel_nehalem, "nehalem", intel_core2, 4,
+    {HW_SSE41, HW_SSE42, HW_POPCNT, HW_END}},
+  {intel_westmere, "westmere", intel_nehalem, 4,
+    {HW_AES, HW_PCLMUL, HW_END}},
+  {intel_sandybridge, "sandybridge", intel_westmere, 4,
+    {HW_AVX, HW_XSAVE, HW_XSAVEOPT, HW_END}},
+  {intel_ivybridge, "ivybridge", intel_sandybridge, 4,
+    {HW_FSGSBASE, HW_RDRND, HW_F16C, HW_END}},
+  {intel_haswell, "haswell", intel_ivybridge, 4,
+    {HW_AVX2, HW_BMI, HW_BMI2, HW_ABM, HW_FMA, HW_MOVBE, HW_HLE, HW_END}},
+  {intel_broadwell, "broadwell", intel_haswell, 4,
+    {HW_ADX, HW_PREFETCHW, HW_RDSEED, HW_END}},
+  {intel_skylake, "skylake", intel_broadwell, 6,
+    {HW_AES, HW_CLFLUSHOPT, HW_XSAVEC, HW_XSAVES, HW_SGX, HW_END}},
+  {intel_bonnell, "bonnell", intel_core2, 4,
+    {HW_MOVBE, HW_END}},
+  {intel_silvermont, "silvermont", intel_westmere, 4,
+    {HW_MOVBE, HW_RDRND, HW_PREFETCHW, HW_END}},
+  {intel_goldmont, "goldmont", intel_silvermont, 9,
+    {HW_AES, HW_SHA, HW_XSAVE, HW_RDSEED, HW_XSAVEC, HW_XSAVES, HW_CLFLUSHOPT,
+     HW_XSAVEOPT, HW_FSGSBASE, HW_END}},
+  {intel_goldmont_plus, "goldmont-plus", intel_goldmont, 9,
+    {HW_RDPID, HW_SGX, HW_PTWRITE, HW_END}},
+  {intel_tremont, "tremont", intel_goldmont_plus, 9,
+    {HW_CLWB, HW_GFNI, HW_MOVDIRI, HW_MOVDIR64B, HW_CLDEMOTE, HW_WAITPKG,
+     HW_END}},
+  {intel_knl, "knl", intel_broadwell, 5,
+    {HW_AVX512PF, HW_AVX512ER, HW_AVX512F, HW_AVX512CD, HW_PREFETCHWT1,
+     HW_END}},
+  {intel_knm, "knm", intel_knl, 8,
+    {HW_AVX5124VNNIW, HW_AVX5124FMAPS, HW_AVX512VPOPCNTDQ, HW_END}},
+  {intel_skylake_avx512, "skylake-avx512", intel_skylake, 6,
+    {HW_AVX512F, HW_AVX512CD, HW_AVX512VL, HW_AVX512BW, HW_AVX512DQ,
+     HW_PKU, HW_CLWB, HW_END}},
+  {intel_cannonlake, "cannonlake", intel_skylake, 8,
+    {HW_AVX512F, HW_AVX512CD, HW_AVX512VL, HW_AVX512BW, HW_AVX512DQ,
+     HW_PKU, HW_AVX512VBMI, HW_AVX512IFMA, HW_SHA, HW_UMIP, HW_END}},
+  {intel_icelake_client, "icelake-client", intel_cannonlake, 8,
+    {HW_RDPID, HW_GFNI, HW_AVX512VBMI2, HW_AVX512VPOPCNTDQ,
+     HW_AVX512BITALG, HW_AVX512VNNI, HW_VPCLMULQDQ, HW_VAES, HW_END}},
+  {intel_icelake_server, "icelake-server", intel_icelake_client, 8,
+    {HW_PCONFIG, HW_CLWB, HW_WBNOINVD, HW_END}},
+  {intel_cascadelake, "cascadelake", intel_skylake_avx512, 9,
+    {HW_AVX512VNNI, HW_END}},
+  {intel_cooperlake, "cooperlake", intel_cascadelake, 10,
+    {HW_AVX512BF16, HW_END}},
+  {intel_tigerlake, "tigerlake", intel_icelake_client, 10,
+    {HW_MOVDIRI, HW_MOVDIR64B, HW_CLWB, HW_AVX512VP2INTERSECT, HW_KL,
+     HW_WIDEKL, HW_END}},
+  {intel_sapphirerapids, "sapphirerapids", intel_icelake_server, 11,
+    {HW_MOVDIRI, HW_MOVDIR64B, HW_ENQCMD, HW_CLDEMOTE, HW_PTWRITE,
+     HW_WAITPKG, HW_SERIALIZE, HW_TSXLDTRK, HW_AMX_TILE, HW_AMX_INT8,
+     HW_AMX_BF16, HW_UINTR, HW_AVXVNNI, HW_AVX512FP16, HW_AVX512BF16,
+     HW_AVX512VP2INTERSECT, HW_END}},
+  {intel_alderlake, "alderlake", intel_tremont, 11,
+    {HW_ADX, HW_AVX, HW_AVX2, HW_BMI, HW_BMI2, HW_F16C, HW_FMA, HW_ABM,
+     HW_PCONFIG, HW_PKU, HW_VAES, HW_VPCLMULQDQ, HW_SERIALIZE, HW_HRESET,
+     HW_KL, HW_WIDEKL, HW_AVXVNNI, HW_END}},
+  {intel_sierraforest, "sierraforest", intel_alderlake, 13,
+    {HW_AVXIFMA, HW_AVXVNNIINT8, HW_AVXNECONVERT, HW_CMPCCXADD, HW_ENQCMD,
+     HW_UINTR, HW_END}},
+  {intel_emeraldrapids, "emeraldrapids", intel_sapphirerapids, 13,
+    {HW_END}},
+  {intel_graniterapids, "graniterapids", intel_sapphirerapids, 13,
+    {HW_AMX_FP16, HW_PREFETCHI, HW_END}},
+  {intel_graniterapids_d, "graniterapids-d", intel_graniterapids, 14,
+    {HW_AMX_COMPLEX, HW_END}},
+  {amd_athlon64, "athlon64", cpu_x86_64, 3,
+    {HW_3DNOW, HW_3DNOWEXT, HW_END}},
+  {amd_athlon64_sse3, "athlon64-sse3", amd_athlon64, 4,
+    {HW_SSE3, HW_END}},
+  {amd_amdfam10, "amdfam10", amd_athlon64_sse3, 4,
+    {HW_SSE4A, HW_CX16, HW_ABM, HW_POPCNT, HW_PREFETCHW, HW_LAHF_LM,
+     HW_END}},
+  {amd_bdver1, "bdver1", cpu_x86_64, 4,
+    {HW_SSE3, HW_SSE4A, HW_CX16, HW_ABM, HW_POPCNT, HW_SSSE3, HW_SSE41,
+     HW_SSE42, HW_AES, HW_PCLMUL, HW_AVX, HW_FMA4, HW_XOP, HW_LWP,
+     HW_PREFETCHW, HW_XSAVE, HW_LAHF_LM, HW_END}},
+  {amd_bdver2, "bdver2", amd_bdver1, 4,
+    {HW_BMI, HW_TBM, HW_F16C, HW_FMA, HW_END}},
+  {amd_bdver3, "bdver3", amd_bdver2, 4,
+    {HW_XSAVEOPT, HW_FSGSBASE, HW_END}},
+  {amd_bdver4, "bdver4", amd_bdver3, 4,
+    {HW_AVX2, HW_BMI2, HW_RDRND, HW_MOVBE, HW_MWAITX, HW_END}},
+  {amd_znver1, "znver1", cpu_x86_64, 6,
+    {HW_SSE3, HW_SSE4A, HW_CX16, HW_ABM, HW_POPCNT, HW_SSSE3, HW_SSE41,
+     HW_SSE42, HW_AES, HW_PCLMUL, HW_AVX, HW_AVX2, HW_BMI, HW_BMI2,
+     HW_F16C, HW_FMA, HW_PREFETCHW, HW_XSAVE, HW_XSAVEOPT, HW_FSGSBASE,
+     HW_RDRND, HW_MOVBE, HW_MWAITX, HW_ADX, HW_RDSEED, HW_CLZERO,
+     HW_CLFLUSHOPT, HW_XSAVEC, HW_XSAVES, HW_SHA, HW_LAHF_LM, HW_END}},
+  {amd_znver2, "znver2", amd_znver1, 9,
+    {HW_CLWB, HW_RDPID, HW_WBNOINVD, HW_END}},
+  {amd_znver3, "znver3", amd_znver2, 11,
+    {HW_VAES, HW_VPCLMULQDQ, HW_PKU, HW_END}},
+  {amd_znver4, "znver4", amd_znver3, 13,
+    {HW_AVX512F, HW_AVX512DQ, HW_AVX512IFMA, HW_AVX512CD, HW_AVX512BW,
+     HW_AVX512VL, HW_AVX512BF16, HW_AVX512VBMI, HW_AVX512VBMI2, HW_GFNI,
+     HW_AVX512VNNI, HW_AVX512BITALG, HW_AVX512VPOPCNTDQ, HW_END}},
+  {amd_znver5, "znver5", amd_znver4, 14,
+    {HW_AVXVNNI, HW_MOVDIRI, HW_MOVDIR64B, HW_AVX512VP2INTERSECT,
+     HW_PREFETCHI, HW_END}},
+  {amd_btver1, "btver1", cpu_x86_64, 4,
+    {HW_SSE3, HW_SSSE3, HW_SSE4A, HW_CX16, HW_ABM, HW_POPCNT,
+     HW_PREFETCHW, HW_XSAVE, HW_LAHF_LM, HW_END}},
+  {amd_btver2, "btver2", amd_btver1, 4,
+    {HW_SSE41, HW_SSE42, HW_AES, HW_PCLMUL, HW_AVX, HW_BMI, HW_F16C,
+     HW_MOVBE, HW_XSAVE, HW_XSAVEOPT, HW_END}},
+  {via_eden_x2, "eden-x2", cpu_x86_64, 7,
+    {HW_SSE3, HW_LAHF_LM, HW_END}},
+  {via_nano, "nano", via_eden_x2, 7,
+    {HW_SSSE3, HW_END}},
+  {via_nano_3000, "nano-3000", via_nano, 7,
+    {HW_SSE41, HW_END}},
+  {via_eden_x4, "eden-x4", via_nano_3000, 7,
+    {HW_END}},
+  {zhaoxin_lujiazui, "lujiazui", cpu_x86_64, 13,
+    {HW_SSE3, HW_CX16, HW_ABM, HW_SSSE3, HW_SSE41, HW_SSE42, HW_AES,
+     HW_PCLMUL, HW_BMI, HW_BMI2, HW_PREFETCHW, HW_XSAVE, HW_XSAVEOPT,
+     HW_FSGSBASE, HW_RDRND, HW_MOVBE, HW_ADX, HW_RDSEED, HW_POPCNT,
+     HW_LAHF_LM, HW_END}},
+  {zhaoxin_yongfeng, "yongfeng", zhaoxin_lujiazui, 14,
+    {HW_AVX, HW_AVX2, HW_F16C, HW_FMA, HW_SHA, HW_END}},
+  {cpu_x86_64, NULL, cpu_x86_64, 0, {HW_END}}
+};
+
+
+/* features gcc dropped from the list of an arch
+
+   from the release gcc on the arch no longer enables the feature,
+   the child archs neither, unless they list it themselves (e.g. gcc 12
+   dropped AES from westmere, skylake and goldmont add it again). The
+   list is terminated by cpu_x86_64.
+*/
+
+typedef struct {
+  int arch;
+  int feature;
+  int gcc;            /* first gcc major release without the feature */
+} _cpu_arch_dropped;
+
+
+_cpu_arch_dropped cpu_arch_dropped[] = {
+  {intel_westmere, HW_AES, 12},
+  {intel_sapphirerapids, HW_AVX512VP2INTERSECT, 13},
+  {cpu_x86_64, HW_END, 0}
+};
+
+
+
+/* OS enablement
+
+   the register states of the SIMD extensions have to be enabled by the
+   OS in XCR0, otherwise the instructions raise #UD. Every feature of a
+   gate list requires all state bits of the gate.
+*/
+
+#define XSTATE_X87        ((uint64_t)1 << 0)
+#define XSTATE_SSE        ((uint64_t)1 << 1)
+#define XSTATE_YMM        ((uint64_t)1 << 2)
+#define XSTATE_BNDREGS    ((uint64_t)1 << 3)
+#define XSTATE_BNDCSR     ((uint64_t)1 << 4)
+#define XSTATE_OPMASK     ((uint64_t)1 << 5)
+#define XSTATE_ZMM_HI256  ((uint64_t)1 << 6)
+#define XSTATE_HI16_ZMM   ((uint64_t)1 << 7)
+#define XSTATE_XTILECFG   ((uint64_t)1 << 17)
+#define XSTATE_XTILEDATA  ((uint64_t)1 << 18)
+
+#define XSTATE_AVX     (XSTATE_SSE | XSTATE_YMM)
+#define XSTATE_AVX512  (XSTATE_AVX | XSTATE_OPMASK | XSTATE_ZMM_HI256 \
+                        | XSTATE_HI16_ZMM)
+#define XSTATE_MPX     (XSTATE_BNDREGS | XSTATE_BNDCSR)
+#define XSTATE_AMX     (XSTATE_XTILECFG | XSTATE_XTILEDATA)
+
+#define GATE_MAX_FEATURES 24
+
+typedef struct {
+  uint64_t xcr0;
+  int      features[GATE_MAX_FEATURES];
+} _xstate_gate;
+
+
+_xstate_gate xstate_gates[] = {
+  {XSTATE_AVX,
+    {HW_AVX, HW_AVX2, HW_FMA, HW_F16C, HW_FMA4, HW_XOP, HW_VAES,
+     HW_VPCLMULQDQ, HW_AVXVNNI, HW_AVXIFMA, HW_AVXVNNIINT8,
+     HW_AVXNECONVERT, HW_AVXVNNIINT16, HW_SHA512, HW_SM3, HW_SM4,
+     HW_END}},
+  {XSTATE_AVX512,
+    {HW_AVX512F, HW_AVX512DQ, HW_AVX512IFMA, HW_AVX512PF, HW_AVX512ER,
+     HW_AVX512CD, HW_AVX512BW, HW_AVX512VL, HW_AVX512VBMI, HW_AVX512VBMI2,
+     HW_AVX512VNNI, HW_AVX512BITALG, HW_AVX512VPOPCNTDQ, HW_AVX5124VNNIW,
+     HW_AVX5124FMAPS, HW_AVX512BF16, HW_AVX512FP16, HW_AVX512VP2INTERSECT,
+     HW_END}},
+  {XSTATE_AMX,
+    {HW_AMX_TILE, HW_AMX_INT8, HW_AMX_BF16, HW_AMX_FP16, HW_AMX_COMPLEX,
+     HW_END}},
+  {XSTATE_MPX,
+    {HW_MPX, HW_END}},
+  {0, {HW_END}}
+};
+
+
+_vendor_strings vendor_string[] = { { CPU_Intel, "GenuineIntel"},
+                                   { CPU_AMD, "AuthenticAMD"},
+                                   { CPU_Centauer, "CentaurHauls"},
+                                   { CPU_Cyrix, "CyrixInstead"},
+                                   { CPU_Hygon, "HygonGenuine"},
+                                   { CPU_Transmeta, "TransmetaCPU"},
+                                   { CPU_Transmeta, "GenuineTMx86"},
+                                   { CPU_NSC, "Geode by NSC"},
+                                   { CPU_NexGen, "NexGenDriven"},
+                                   { CPU_Rise, "RiseRiseRise"},
+                                   { CPU_SiS, "SiS SiS SiS "},
+                                   { CPU_UMC, "UMC UMC UMC "},
+                                   { CPU_VIA, "VIA VIA VIA "},
+                                   { CPU_Vortex, "Vortex86 SoC"},
+                                   { CPU_Zhaoxin, "  Shanghai  "},
+                                   { CPU_UNKNOWN, NULL }
+                                 };
+
+
+typedef struct {
+  int   id;
+  char *signature;
+  char *name;
+} _hypervisor_strings;
+
+
+_hypervisor_strings hypervisor_string[] = {
+  { HV_KVM, "KVMKVMKVM", "KVM" },
+  { HV_KVM, "Linux KVM Hv", "KVM" },
+  { HV_HYPERV, "Microsoft Hv", "Hyper-V" },
+  { HV_VMWARE, "VMwareVMware", "VMware" },
+  { HV_XEN, "XenVMMXenVMM", "Xen" },
+  { HV_QEMU, "TCGTCGTCGTCG", "QEMU" },
+  { HV_VIRTUALBOX, "VBoxVBoxVBox", "VirtualBox" },
+  { HV_PARALLELS, " lrpepyh  vr", "Parallels" },
+  { HV_BHYVE, "bhyve bhyve ", "bhyve" },
+  { HV_ACRN, "ACRNACRNACRN", "ACRN" },
+  { HV_QNX, "QNXQVMBSQG", "QNX" },
+  { HV_UNKNOWN, NULL, "unknown" }
+};
+
+
+/* cpu_manufacturer_id
+
+the result is stored in that order, a, c, b corresponding to
+EBX, EDX, ECX!
+*/
+
+void cpu_manufacturer_id(char *vendor, int a, int c, int b)
+{
+  vendor[12] = '\0';
+  vendor[0] = (char)(a >> 0) & 0xff;
+  vendor[1] = (char)(a >> 8) & 0xff;
+  vendor[2] = (char)(a >> 16) & 0xff;
+  vendor[3] = (char)(a >> 24) & 0xff;
+  vendor[4] = (char)(b >> 0) & 0xff;
+  vendor[5] = (char)(b >> 8) & 0xff;
+  vendor[6] = (char)(b >> 16) & 0xff;
+  vendor[7] = (char)(b >> 24) & 0xff;
+  vendor[8] = (char)(c >> 0) & 0xff;
+  vendor[9] = (char)(c >> 8) & 0xff;
+  vendor[10] = (char)(c >> 16) & 0xff;
+  vendor[11] = (char)(c >> 24) & 0xff;
+}
+
+
+/* str_equal
+
+compares two strings without libc, the detection has to
+run inside of ifunc resolvers
+*/
+
+int str_equal(const char *a, const char *b)
+{
+  while ((*a != '\0') && (*a == *b))
+  {
+    ++a;
+    ++b;
+  }
+
+  return *a == *b;
+}
+
+
+/* get_cpu_type
+
+maps a vendor string of leaf 0 to the CPU_* vendor id
+*/
+
+int get_cpu_type(const char *vendor)
+{
+  int i = 0;
+
+  while (vendor_string[i].id != CPU_UNKNOWN)
+  {
+    if (str_equal(vendor, vendor_string[i].vendor))
+      return vendor_string[i].id;
+    ++i;
+  }
+
+  return CPU_UNKNOWN;
+}
+
+
+/* get_hypervisor_entry
+
+maps the signature of a hypervisor leaf to its table entry, the
+last entry for unknown hypervisors
+*/
+
+static _hypervisor_strings *get_hypervisor_entry(const char *signature)
+{
+  int i = 0;
+
+  while (hypervisor_string[i].id != HV_UNKNOWN)
+  {
+    if (str_equal(signature, hypervisor_string[i].signature))
+      break;
+    ++i;
+  }
+
+  return &hypervisor_string[i];
+}
+
+
+/* get_hypervisor
+
+identifies the hypervisor from leaf 40000000h, the signature is in
+EBX, ECX, EDX. Hypervisors which offer the Hyper-V interface to
+Windows guests (Xen, KVM) move their own leaves up to 40000100h.
+*/
+
+void get_hypervisor(void)
+{
+  int          info[4];
+  unsigned int leaf;
+  char         signature[13];
+  int          i;
+
+  dcpu_cpu.hypervisor_type = HV_NONE;
+  dcpu_cpu.hypervisor[0] = '\0';
+  dcpu_cpu.hypervisor_leaf = 0;
+  dcpu_cpu.hypervisor_level = 0;
+
+  if (!featureset_has(&dcpu_cpu.hw_features, HW_HYPERVISOR))
+    return;
+
+  for (leaf = 0x40000000; leaf <= 0x40000100; leaf += 0x100)
+  {
+    cpuid(info, leaf);
+    cpu_manufacturer_id(signature, info[1], info[3], info[2]);
+    if ((leaf > 0x40000000)
+        && ((get_hypervisor_entry(signature)->id == HV_UNKNOWN)
+            || ((unsigned int)info[0] < leaf)))
+      break;
+
+    dcpu_cpu.hypervisor_type = get_hypervisor_entry(signature)->id;
+    for (i = 0; i < 13; ++i)
+      dcpu_cpu.hypervisor[i] = signature[i];
+    dcpu_cpu.hypervisor_leaf = leaf;
+    /* old KVM versions report 0, they have 40000001h */
+    dcpu_cpu.hypervisor_level = ((unsigned int)info[0] < leaf)
+                                ? leaf + 1 : (unsigned int)info[0];
+
+    if (dcpu_cpu.hypervisor_type != HV_HYPERV)
+      break;
+  }
+}
+
+
+void set_cpu_type(void)
+{
+  dcpu_cpu.cpu_type = get_cpu_type(dcpu_cpu.vendor);
+}
+
+
+/* cpuid_leaf_valid
+
+checks, if the leaf is in the range of the supported basic or
+extended leaves
+*/
+
+static int leaf_in_range(unsigned int leaf, unsigned int level,
+                         unsigned int ext_level)
+{
+  if (leaf >= 0x80000000)
+    return leaf <= ext_level;
+  else
+    return leaf <= level;
+}
+
+
+int cpuid_leaf_valid(unsigned int leaf)
+{
+  return leaf_in_range(leaf, dcpu_cpu.cpuid_level, dcpu_cpu.cpuid_ext_level);
+}
+
+
+/* features which AMD reports in another leaf than Intel, the bit sets
+   the feature of the table as well
+*/
+
+typedef struct {
+  int          id;
+  unsigned int leaf;
+  int          reg;
+  int          bit;
+} _feature_alias;
+
+
+static _feature_alias feature_aliases[] = {
+  {HW_PREFETCHI, 0x80000021, REG_EAX, 20},
+  {HW_END, 0, 0, 0}
+};
+
+
+/* decode_features
+
+walks through the feature specification and sets the feature bits
+of a dump (NULL for the current CPUID source), a leaf/subleaf is only
+requested again, if it changes between two consecutive table entries
+*/
+
+static void decode_features(const _cpuid_dump *dump, unsigned int level,
+                            unsigned int ext_level, _cpu_featureset *set)
+{
+  int          info[4] = { 0, 0, 0, 0 };
+  unsigned int leaf = 0;
+  unsigned int subleaf = 0;
+  int          valid = 0;
+  int          i;
+  _cpu_feature *f;
+
+  featureset_clear(set);
+
+  for (i = 0; i < HW_NUM_FEATURES; ++i)
+  {
+    f = &cpu_feature_spec[i];
+    if ((i == 0) || (f->leaf != leaf) || (f->subleaf != subleaf))
+    {
+      leaf = f->leaf;
+      subleaf = f->subleaf;
+      valid = leaf_in_range(leaf, level, ext_level);
+      if (valid)
+        dump_cpuid(dump, info, leaf, subleaf);
+    }
+
+    if (valid && ((((unsigned int)info[f->reg]) >> f->bit) & 1))
+      featureset_set(set, i);
+  }
+
+  for (i = 0; feature_aliases[i].id != HW_END; ++i)
+  {
+    if (!leaf_in_range(feature_aliases[i].leaf, level, ext_level))
+      continue;
+    dump_cpuid(dump, info, feature_aliases[i].leaf, 0);
+    if ((((unsigned int)info[feature_aliases[i].reg])
+         >> feature_aliases[i].bit) & 1)
+      featureset_set(set, feature_aliases[i].id);
+  }
+}
+
+
+void decode_cpu_features(_cpu_featureset *set)
+{
+  decode_features(NULL, dcpu_cpu.cpuid_level, dcpu_cpu.cpuid_ext_level, set);
+}
+
+
+/* get_xcr0
+
+returns the OS enabled register states, 0 if XGETBV is not usable
+*/
+
+uint64_t get_xcr0(void)
+{
+  if (!featureset_has(&dcpu_cpu.hw_features, HW_OSXSAVE))
+    return 0;
+
+  return xgetbv(0);
+}
+
+
+/* apply_xstate_gates
+
+removes the features whose register states are not enabled in xcr0
+*/
+
+void apply_xstate_gates(_cpu_featureset *set, uint64_t xcr0)
+{
+  _xstate_gate *g;
+  int           i;
+
+  for (g = xstate_gates; g->xcr0 != 0; ++g)
+  {
+    if ((xcr0 & g->xcr0) == g->xcr0)
+      continue;
+    for (i = 0; (i < GATE_MAX_FEATURES) && (g->features[i] != HW_END); ++i)
+      featureset_unset(set, g->features[i]);
+  }
+}
+
+
+/* get_cpu_signature
+
+returns the processor signature (family, model, stepping) of EAX=1
+*/
+
+unsigned int get_cpu_signature(void)
+{
+  int info[4];
+
+  if (!cpuid_leaf_valid(0x00000001))
+    return 0;
+
+  cpuid(info, 0x00000001);
+
+  return (unsigned int)info[0];
+}
+
+
+/* get_cpu_brand
+
+reads the brand string from the leaves 80000002h-80000004h
+*/
+
+void get_cpu_brand(char *brand)
+{
+  int info[4];
+  int i, j;
+
+  brand[0] = '\0';
+  if (!cpuid_leaf_valid(0x80000004))
+    return;
+
+  for (i = 0; i < 3; ++i)
+  {
+    cpuid(info, 0x80000002 + i);
+    for (j = 0; j < 16; ++j)
+      brand[i * 16 + j] = (char)((info[j / 4] >> (8 * (j % 4))) & 0xff);
+  }
+  brand[48] = '\0';
+}
+
+
+void get_cpu_flags(void)
+{
+  int info[4];
+  int nIds;
+  unsigned nExIds;
+
+  cpuid(info, 0);
+  nIds = info[0];   /* the maximum leaf for question with cpuid */
+  dcpu_cpu.cpuid_level = nIds;
+
+  /* read the vendor string */
+  cpu_manufacturer_id(dcpu_cpu.vendor, info[1], info[2], info[3]);
+  set_cpu_type();
+
+  cpuid(info, 0x80000000);
+  nExIds = info[0];  /* the maximum leaf for extended couid questions*/
+  dcpu_cpu.cpuid_ext_level = nExIds;
+
+  dcpu_cpu.signature = get_cpu_signature();
+  decode_cpu_features(&dcpu_cpu.hw_features);
+  get_cpu_brand(dcpu_cpu.brand);
+
+  /* only report what the OS allows to use */
+  dcpu_cpu.xcr0 = get_xcr0();
+  dcpu_cpu.features = dcpu_cpu.hw_features;
+  apply_xstate_gates(&dcpu_cpu.features, dcpu_cpu.xcr0);
+}
+
+
+_cpu_arch *find_arch(int arch)
+{
+  int i = 0;
+
+  while (cpu_archs[i].id != cpu_x86_64)
+  {
+    if (cpu_archs[i].id == arch)
+      return &cpu_archs[i];
+    ++i;
+  }
+
+  return NULL;
+}
+
+
+const char *get_arch_name(int arch)
+{
+  _cpu_arch *a = find_arch(arch);
+
+  if (a == NULL)
+    return "x86-64";
+
+  return a->arch;
+}
+
+
+/* get_arch_gcc
+
+returns the first gcc major release knowing -march=arch, 0 for the
+x86-64 baseline
+*/
+
+int get_arch_gcc(int arch)
+{
+  _cpu_arch *a = find_arch(arch);
+
+  if (a == NULL)
+    return 0;
+
+  return a->gcc;
+}
+
+
+/* arch_dropped
+
+returns 1 if the gcc major release gcc doesn't enable the feature of
+the arch list any more, 0 means the newest gcc
+*/
+
+static int arch_dropped(int arch, int feature, int gcc)
+{
+  int i;
+
+  for (i = 0; cpu_arch_dropped[i].arch != cpu_x86_64; ++i)
+    if ((cpu_arch_dropped[i].arch == arch)
+        && (cpu_arch_dropped[i].feature == feature))
+      return (gcc <= 0) || (gcc >= cpu_arch_dropped[i].gcc);
+
+  return 0;
+}
+
+
+/* get_arch_features_for
+
+collects all features a gcc of the major release gcc enables for an
+arch, walking up the parent archs down to the x86-64 baseline, 0 means
+the newest gcc
+*/
+
+void get_arch_features_for(int arch, int gcc, _cpu_featureset *set)
+{
+  _cpu_arch *a;
+  int        i;
+
+  featureset_clear(set);
+
+  for (i = 0; x86_64_features[i] != HW_END; ++i)
+    featureset_set(set, x86_64_features[i]);
+
+  while ((a = find_arch(arch)) != NULL)
+  {
+    for (i = 0; (i < ARCH_MAX_FEATURES) && (a->features[i] != HW_END); ++i)
+      if (!arch_dropped(arch, a->features[i], gcc))
+        featureset_set(set, a->features[i]);
+    arch = a->parent;
+  }
+}
+
+
+/* get_arch_features
+
+collects all features the newest gcc enables for an arch
+*/
+
+void get_arch_features(int arch, _cpu_featureset *set)
+{
+  get_arch_features_for(arch, 0, set);
+}
+
+
+/* get_x86_64_level
+
+returns the highest x86-64 psABI level whose features are all
+available
+*/
+
+int get_x86_64_level(const _cpu_featureset *features)
+{
+  _cpu_featureset req;
+  int             level;
+
+  for (level = cpu_x86_64_v4; level > cpu_x86_64; --level)
+  {
+    get_arch_features(level, &req);
+    if (featureset_contains(features, &req))
+      return level;
+  }
+
+  return cpu_x86_64;
+}
+
+
+int get_gcc_arch_type_intel(const _cpu_featureset *features)
+{
+  if (cpu_has(HW_MMX) && cpu_has(HW_SSE) && cpu_has(HW_SSE2)
+      && cpu_has(HW_SSE3) && cpu_has(HW_SSSE3))
+  {
+    if (cpu_has(HW_SSE41) && cpu_has(HW_SSE42) && cpu_has(HW_POPCNT))
+    {
+      if (cpu_has(HW_AES) && cpu_has(HW_PCLMUL))
+      {
+        if (cpu_has(HW_AVX))
+        {
+          if (cpu_has(HW_FSGSBASE) && cpu_has(HW_RDRND) && cpu_has(HW_F16C))
+          {
+            if (cpu_has(HW_MOVBE) && cpu_has(HW_AVX2) && cpu_has(HW_FMA)
+                && cpu_has(HW_BMI) && cpu_has(HW_BMI2))
+            {
+              /* RDSEED only by intrinsics, kernels clear it for errata */
+              if (cpu_has(HW_ADX) && cpu_has(HW_PREFETCHW))
+              {
+                if (cpu_has(HW_CLFLUSHOPT) && cpu_has(HW_XSAVEC)
+                    && cpu_has(HW_XSAVES))
+                {
+                  if (cpu_has(HW_PKU) && cpu_has(HW_AVX512F)
+                      && cpu_has(HW_AVX512VL)
+                      && cpu_has(HW_AVX512BW) && cpu_has(HW_AVX512DQ)
+                      && cpu_has(HW_AVX512CD))
+                  {
+                    int icelake = cpu_has(HW_AVX512VBMI)
+                      && cpu_has(HW_AVX512IFMA) && cpu_has(HW_SHA)
+                      && cpu_has(HW_RDPID) && cpu_has(HW_GFNI)
+                      && cpu_has(HW_AVX512VBMI2)
+                      && cpu_has(HW_AVX512VPOPCNTDQ)
+                      && cpu_has(HW_AVX512BITALG) && cpu_has(HW_AVX512VNNI)
+                      && cpu_has(HW_VPCLMULQDQ) && cpu_has(HW_VAES);
+
+                    if (cpu_has(HW_CLWB))
+                      {
+                        /* of the icelakes only the server has CLWB,
+                           tigerlake added it to the client */
+                        if (icelake)
+                        {
+                          if (cpu_has(HW_AMX_TILE) && cpu_has(HW_AMX_INT8)
+                              && cpu_has(HW_AMX_BF16)
+                              && cpu_has(HW_AVX512FP16)
+                              && cpu_has(HW_AVX512BF16)
+                              && cpu_has(HW_AVXVNNI) && cpu_has(HW_MOVDIRI)
+                              && cpu_has(HW_MOVDIR64B)
+                              && cpu_has(HW_SERIALIZE))
+                          {
+                            /* emeraldrapids has the same features as
+                               sapphirerapids */
+                            if (cpu_has(HW_AMX_FP16) && cpu_has(HW_PREFETCHI))
+                            {
+                              if (cpu_has(HW_AMX_COMPLEX))
+                                return intel_graniterapids_d;
+                              else
+                                return intel_graniterapids;
+                            }
+                            else
+                              return intel_sapphirerapids;
+                          }
+                          else if (cpu_has(HW_AVX512VP2INTERSECT)
+                                   && cpu_has(HW_MOVDIRI)
+                                   && cpu_has(HW_MOVDIR64B))
+                            return intel_tigerlake;
+                          else
+                            return intel_icelake_server;
+                        }
+                        else if (cpu_has(HW_AVX512VNNI))
+                        {
+                          if (cpu_has(HW_AVX512BF16))
+                            return intel_cooperlake;
+                          else
+                            return intel_cascadelake;
+                        }
+                        else
+                          return intel_skylake_avx512;
+                      }
+                    else
+                      /* cannonlake doesn't support CLWB! */
+                      if (cpu_has(HW_AVX512VBMI) && cpu_has(HW_AVX512IFMA)
+                          && cpu_has(HW_SHA) && cpu_has(HW_UMIP))
+                      {
+                        if (icelake)
+                          return intel_icelake_client;
+                        else
+                          return intel_cannonlake;
+                      }
+                  }
+                  else
+                  {
+                    /* the hybrid parts and the E-core Xeons have
+                       AVX-VNNI, but no AVX-512 */
+                    if (cpu_has(HW_AVXVNNI) && cpu_has(HW_SERIALIZE)
+                        && cpu_has(HW_GFNI) && cpu_has(HW_VAES)
+                        && cpu_has(HW_MOVDIRI) && cpu_has(HW_WAITPKG))
+                    {
+                      if (cpu_has(HW_AVXIFMA) && cpu_has(HW_AVXVNNIINT8)
+                          && cpu_has(HW_AVXNECONVERT)
+                          && cpu_has(HW_CMPCCXADD))
+                        return intel_sierraforest;
+                      else
+                        return intel_alderlake;
+                    }
+                    return intel_skylake;
+                  }
+                }
+                else
+                  {
+                    if (cpu_has(HW_AVX512F) && cpu_has(HW_AVX512PF)
+                        && cpu_has(HW_AVX512ER) && cpu_has(HW_AVX512CD))
+                    {
+                      if (cpu_has(HW_AVX5124VNNIW) && cpu_has(HW_AVX5124FMAPS)
+                          && cpu_has(HW_AVX512VPOPCNTDQ))
+                        return intel_knm;
+                      else
+                        return intel_knl;
+                    }
+                    else
+                      return intel_broadwell;
+                  }
+              }
+              else
+                return intel_haswell;
+            }
+            return intel_ivybridge;
+          }
+          return intel_sandybridge;
+        }
+        else
+        {
+          if (cpu_has(HW_MOVBE) && cpu_has(HW_RDRND))
+          {
+            if (cpu_has(HW_XSAVE) && cpu_has(HW_XSAVEOPT)
+                && cpu_has(HW_FSGSBASE))
+            {
+              if (cpu_has(HW_PTWRITE) && cpu_has(HW_RDPID) && cpu_has(HW_SGX)
+                  && cpu_has(HW_UMIP))
+              {
+                if (cpu_has(HW_GFNI_SSE) && cpu_has(HW_CLWB))
+                  /* in the documentation HW_ENCLV should be
+                    detected, but this is not documented how ... */
+                  return intel_tremont;
+                else
+                  return intel_goldmont_plus;
+              }
+              else
+                return intel_goldmont;
+            }
+            else
+              return intel_silvermont;
+          }
+          else
+            return intel_westmere;
+        }
+      }
+      return intel_nehalem;
+    }
+
+    if (cpu_has(HW_MOVBE))
+      return intel_bonnell;
+
+    return intel_core2;
+  }
+  else
+    return cpu_x86_64;
+}
+
+
+int get_gcc_arch_type_amd(const _cpu_featureset *features)
+{
+  if (cpu_has(HW_MMX) && cpu_has(HW_SSE) && cpu_has(HW_SSE2))
+  {
+    if (cpu_has(HW_SSE3) && cpu_has(HW_SSSE3) && cpu_has(HW_SSE4A)
+        && cpu_has(HW_CX16) && cpu_has(HW_ABM))
+    {
+      if (cpu_has(HW_AVX) && cpu_has(HW_AES) && cpu_has(HW_PCLMUL)
+          && cpu_has(HW_SSE41) && cpu_has(HW_SSE42) )
+      {
+        if (cpu_has(HW_FMA4) && cpu_has(HW_XOP) && cpu_has(HW_LWP))
+        {
+          //printf("test2\n");
+          if (cpu_has(HW_BMI) && cpu_has(HW_TBM) && cpu_has(HW_F16C)
+              && cpu_has(HW_FMA))
+          {
+            //printf("test3\n");
+            if (cpu_has(HW_FSGSBASE))
+            {
+              if (cpu_has(HW_BMI2) && cpu_has(HW_AVX2) && cpu_has(HW_MOVBE))
+                return amd_bdver4;
+              else
+                return amd_bdver3;
+            }
+            else
+              return amd_bdver2;
+          }
+          else
+            return amd_bdver1;
+        }
+
+        //printf("test1\n");
+        if (cpu_has(HW_MOVBE) && cpu_has(HW_F16C) && cpu_has(HW_BMI))
+        {
+          /* ZEN micro tech */
+          if (cpu_has(HW_BMI2) && cpu_has(HW_FMA) && cpu_has(HW_FSGSBASE)
+              && cpu_has(HW_AVX2) && cpu_has(HW_ADCX) && cpu_has(HW_SHA)
+              && cpu_has(HW_CLZERO)
+              && cpu_has(HW_XSAVEC) && cpu_has(HW_XSAVES)
+              && cpu_has(HW_CLFLUSHOPT) && cpu_has(HW_POPCNT))
+          {
+            /* MWAITX is not required, hypervisors usually hide it,
+               neither is RDSEED, the kernel clears it on Zen5 for
+               its erratum. gcc emits both only for intrinsics. */
+            if (cpu_has(HW_CLWB))
+            {
+              if (cpu_has(HW_VAES) && cpu_has(HW_VPCLMULQDQ))
+              {
+                if (cpu_has(HW_AVX512F) && cpu_has(HW_AVX512DQ)
+                    && cpu_has(HW_AVX512CD) && cpu_has(HW_AVX512BW)
+                    && cpu_has(HW_AVX512VL) && cpu_has(HW_AVX512IFMA)
+                    && cpu_has(HW_AVX512VBMI) && cpu_has(HW_AVX512VBMI2)
+                    && cpu_has(HW_AVX512VNNI) && cpu_has(HW_AVX512BF16)
+                    && cpu_has(HW_AVX512BITALG)
+                    && cpu_has(HW_AVX512VPOPCNTDQ))
+                {
+                  if (cpu_has(HW_AVXVNNI) && cpu_has(HW_MOVDIRI)
+                      && cpu_has(HW_AVX512VP2INTERSECT))
+                    return amd_znver5;
+                  else
+                    return amd_znver4;
+                }
+                else
+                  return amd_znver3;
+              }
+              else
+                return amd_znver2;
+            }
+            else
+              return amd_znver1;
+          }
+          else
+            return amd_btver2;
+        }
+      }
+      else
+        return amd_btver1;
+    }
+
+    if (cpu_has(HW_3DNOW) && cpu_has(HW_3DNOWEXT))
+    {
+      if (cpu_has(HW_SSE3))
+      {
+        if (cpu_has(HW_SSE4A) && cpu_has(HW_ABM))
+          return amd_amdfam10;
+        else
+          return amd_athlon64_sse3;
+      }
+      else
+        return amd_athlon64;
+    }
+  }
+
+  return cpu_x86_64;
+}
+
+/* get_gcc_arch_type_centaur
+
+Centaur (VIA) and Zhaoxin, the newer Zhaoxin parts still report
+CentaurHauls, therefore the features decide
+*/
+
+int get_gcc_arch_type_centaur(const _cpu_featureset *features)
+{
+  if (cpu_has(HW_SSE42) && cpu_has(HW_AES) && cpu_has(HW_PCLMUL)
+      && cpu_has(HW_BMI) && cpu_has(HW_BMI2) && cpu_has(HW_MOVBE)
+      && cpu_has(HW_ADX) && cpu_has(HW_FSGSBASE))
+  {
+    /* Zhaoxin KX-6000 and newer */
+    if (cpu_has(HW_AVX2) && cpu_has(HW_FMA) && cpu_has(HW_F16C)
+        && cpu_has(HW_SHA))
+      return zhaoxin_yongfeng;
+    else
+      return zhaoxin_lujiazui;
+  }
+
+  if (cpu_has(HW_SSE3))
+  {
+    if (cpu_has(HW_SSSE3))
+    {
+      if (cpu_has(HW_SSE41))
+      {
+        if (cpu_has(HW_SSE42) && cpu_has(HW_AVX2))
+          return via_eden_x4;
+        else
+          return via_nano_3000;
+      }
+      else
+        return via_nano;
+    }
+    else
+      return via_eden_x2;
+  }
+
+  return cpu_x86_64;
+}
+
+
+/* get_gcc_arch_type
+
+classifies a feature set of a vendor, the feature set doesn't need
+to be the one of this host
+*/
+
+int get_gcc_arch_type(int cpu_type, const _cpu_featureset *features)
+{
+  switch(cpu_type)
+  {
+    case CPU_Intel:
+        return get_gcc_arch_type_intel(features);
+        break;
+    case CPU_AMD:
+    case CPU_Hygon:
+        /* Hygon Dhyana is a Zen1 */
+        return get_gcc_arch_type_amd(features);
+        break;
+    case CPU_Centauer:
+    case CPU_VIA:
+    case CPU_Zhaoxin:
+        return get_gcc_arch_type_centaur(features);
+        break;
+    default:
+        return cpu_x86_64;
+        break;
+  }
+}
+
+
+
+/* decode_host
+
+classifies the processor of a dump without touching the state of
+the library, safe to run in parallel for different dumps
+*/
+
+void decode_host(const _cpuid_dump *dump, _cpu_host *host)
+{
+  int          info[4];
+  char         vendor[13];
+  unsigned int level, ext_level;
+  int          model;
+
+  dump_cpuid(dump, info, 0, 0);
+  level = (unsigned int)info[0];
+  cpu_manufacturer_id(vendor, info[1], info[2], info[3]);
+  host->cpu_type = get_cpu_type(vendor);
+
+  dump_cpuid(dump, info, 0x80000000, 0);
+  ext_level = (unsigned int)info[0];
+
+  host->signature = 0;
+  if (level >= 1)
+  {
+    dump_cpuid(dump, info, 1, 0);
+    host->signature = (unsigned int)info[0];
+  }
+
+  decode_features(dump, level, ext_level, &host->features);
+  host->xcr0 = featureset_has(&host->features, HW_OSXSAVE) ? dump->xcr0 : 0;
+  apply_xstate_gates(&host->features, host->xcr0);
+
+  model = get_model_arch(host->cpu_type, host->signature);
+  host->arch = refine_arch(get_gcc_arch_type(host->cpu_type, &host->features),
+                           model, &host->features);
+  host->level = get_x86_64_level(&host->features);
+  host->tune = (model >= 0) ? model : host->arch;
+}
+
+
+/* get_masked_features
+
+collects the features gcc enables for the arch of the model, but the
+hardware features lack, empty for unknown models
+*/
+
+void get_masked_features(_cpu_featureset *masked, int model,
+                         const _cpu_featureset *hw_features)
+{
+  int i;
+
+  featureset_clear(masked);
+  if (model < 0)
+    return;
+
+  get_arch_features(model, masked);
+  for (i = 0; i < HW_NUM_FEATURES; ++i)
+    if (featureset_has(hw_features, i))
+      featureset_unset(masked, i);
+}
+
+
+/* get_amx_palette
+
+reads the tile geometry of palette 1 from leaf 1Dh, the only palette
+defined so far
+*/
+
+void get_amx_palette(void)
+{
+  int info[4];
+
+  dcpu_cpu.amx_tiles = 0;
+  dcpu_cpu.amx_rows = 0;
+  dcpu_cpu.amx_bytes_per_row = 0;
+
+  if (!featureset_has(&dcpu_cpu.features, HW_AMX_TILE)
+      || !cpuid_leaf_valid(0x0000001d))
+    return;
+
+  cpuidcx(info, 0x0000001d, 0);
+  if (info[0] < 1)
+    return;
+
+  cpuidcx(info, 0x0000001d, 1);
+  dcpu_cpu.amx_tiles = (info[1] >> 16) & 0xffff;
+  dcpu_cpu.amx_bytes_per_row = info[1] & 0xffff;
+  dcpu_cpu.amx_rows = info[2] & 0xffff;
+}
+
+
+/* detect_cpu
+
+fills dcpu_cpu from the current CPUID source
+*/
+
+void detect_cpu(void)
+{
+  int model;
+
+  dcpu_cpu.cpuid_faulting = cpuid_replaying() ? 0 : cpuid_probe_faulting();
+  get_cpu_flags();
+  model = get_model_arch(dcpu_cpu.cpu_type, dcpu_cpu.signature);
+  dcpu_cpu.arch = refine_arch(get_gcc_arch_type(dcpu_cpu.cpu_type,
+                                                &dcpu_cpu.features),
+                              model, &dcpu_cpu.features);
+  dcpu_cpu.level = get_x86_64_level(&dcpu_cpu.features);
+  dcpu_cpu.tune = (model >= 0) ? model : dcpu_cpu.arch;
+  get_hypervisor();
+  get_masked_features(&dcpu_cpu.masked, model, &dcpu_cpu.hw_features);
+  get_amx_palette();
+  get_cpu_caches();
+}
+
+
+/* library interface */
+
+/* initialization states */
+#define init_none    0
+#define init_running 1
+#define init_done    2
+
+static int init_state = init_none;
+
+
+/* dcpu_init
+
+runs the detection exactly once, concurrent callers wait until the
+first caller has finished. The guard uses only atomic builtins, no
+libc calls are involved.
+*/
+
+int dcpu_init(void)
+{
+  int expected = init_none;
+
+  if (__atomic_load_n(&dcpu_initialized, __ATOMIC_ACQUIRE))
+    return 0;
+
+  if (__atomic_compare_exchange_n(&init_state, &expected, init_running, 0,
+                                  __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+  {
+    detect_cpu();
+    __atomic_store_n(&init_state, init_done, __ATOMIC_RELEASE);
+    __atomic_store_n(&dcpu_initialized, 1, __ATOMIC_RELEASE);
+  }
+  else
+  {
+    while (__atomic_load_n(&init_state, __ATOMIC_ACQUIRE) != init_done)
+      __builtin_ia32_pause();
+  }
+
+  return 0;
+}
+
+
+const _cpu_info *dcpu_info(void)
+{
+  dcpu_init();
+  return &dcpu_cpu;
+}
+
+
+const char *dcpu_arch(void)
+{
+  dcpu_init();
+  return get_arch_name(dcpu_cpu.arch);
+}
+
+
+const char *dcpu_level(void)
+{
+  dcpu_init();
+  return get_arch_name(dcpu_cpu.level);
+}
+
+
+const char *dcpu_tune(void)
+{
+  dcpu_init();
+  return get_arch_name(dcpu_cpu.tune);
+}
+
+
+const char *dcpu_brand(void)
+{
+  dcpu_init();
+  return dcpu_cpu.brand;
+}
+
+
+const char *dcpu_vendor(void)
+{
+  dcpu_init();
+  return dcpu_cpu.vendor;
+}
+
+
+int dcpu_vendor_type(const char *vendor)
+{
+  return get_cpu_type(vendor);
+}
+
+
+int dcpu_classify(int cpu_type, const _cpu_featureset *features)
+{
+  return get_gcc_arch_type(cpu_type, features);
+}
+
+
+int dcpu_classify_level(const _cpu_featureset *features)
+{
+  return get_x86_64_level(features);
+}
+
+
+const char *dcpu_arch_name(int arch)
+{
+  return get_arch_name(arch);
+}
+
+
+void dcpu_arch_features(int arch, _cpu_featureset *set)
+{
+  get_arch_features(arch, set);
+}
+
+
+/* dcpu_arch_parent
+
+returns the parent arch, -1 for the x86-64 baseline and unknown archs
+*/
+
+int dcpu_arch_parent(int arch)
+{
+  _cpu_arch *a = find_arch(arch);
+
+  if (a == NULL)
+    return -1;
+
+  return a->parent;
+}
+
+
+/* dcpu_gcc_arch
+
+returns the arch itself or the nearest parent arch, which a gcc of
+the major release gcc knows, 0 means any gcc
+*/
+
+int dcpu_gcc_arch(int arch, int gcc)
+{
+  _cpu_arch *a;
+
+  if (gcc <= 0)
+    return arch;
+
+  while (((a = find_arch(arch)) != NULL) && (a->gcc > gcc))
+    arch = a->parent;
+
+  return arch;
+}
+
+
+int dcpu_supports_arch(int arch)
+{
+  _cpu_featureset req;
+
+  dcpu_init();
+  get_arch_features(arch, &req);
+
+  return featureset_contains(&dcpu_cpu.features, &req);
+}
+
+
+/* dcpu_arch_ranking
+
+fills archs with the gcc archs (no x86-64 levels) this CPU can run,
+best first: the detected arch and its parent archs, plus every other
+arch whose features are all available (e.g. cascadelake for a
+sapphirerapids, which isn't a parent), ordered by the number of
+features gcc enables, the parents before other archs of the same
+size. Returns the number of archs, at most max.
+*/
+
+int dcpu_arch_ranking(int *archs, int max)
+{
+  _cpu_featureset req;
+  int             size[sizeof(cpu_archs) / sizeof(cpu_archs[0])];
+  int             n = 0, arch, i, j, s, chain;
+
+  dcpu_init();
+
+  for (i = 0; cpu_archs[i].id != cpu_x86_64; ++i)
+  {
+    if (cpu_archs[i].id <= cpu_x86_64_v4)
+      continue;
+
+    /* the parents are usable even with hidden features like MWAITX */
+    chain = 0;
+    for (arch = dcpu_cpu.arch; arch > cpu_x86_64_v4;
+         arch = dcpu_arch_parent(arch))
+      if (arch == cpu_archs[i].id)
+        chain = 1;
+    get_arch_features(cpu_archs[i].id, &req);
+    if (!chain && !featureset_contains(&dcpu_cpu.features, &req))
+      continue;
+
+    /* insertion sort, the size counts twice, the chain breaks ties */
+    s = 2 * featureset_count(&req) + chain;
+    if (n < max)
+      ++n;
+    else if ((n == 0) || (size[n - 1] >= s))
+      continue;
+    for (j = n - 1; (j > 0) && (size[j - 1] < s); --j)
+    {
+      archs[j] = archs[j - 1];
+      size[j] = size[j - 1];
+    }
+    archs[j] = cpu_archs[i].id;
+    size[j] = s;
+  }
+
+  return n;
+}
+
+
+/* dcpu_arch_id
+
+returns the arch id of a gcc arch or x86-64 level name, -1 if
+the name is unknown
+*/
+
+int dcpu_arch_id(const char *name)
+{
+  int i = 0;
+
+  if (str_equal(name, "x86-64"))
+    return cpu_x86_64;
+
+  while (cpu_archs[i].id != cpu_x86_64)
+  {
+    if (str_equal(name, cpu_archs[i].arch))
+      return cpu_archs[i].id;
+    ++i;
+  }
+
+  return -1;
+}
+
+
+int dcpu_feature_id(const char *name)
+{
+  int i;
+
+  for (i = 0; i < HW_NUM_FEATURES; ++i)
+    if (str_equal(name, cpu_feature_spec[i].name))
+      return i;
+
+  return -1;
+}
+
+
+/* dcpu_masked
+
+returns 1 if the family/model implies the feature, but CPUID doesn't
+report it
+*/
+
+int dcpu_masked(int feature)
+{
+  dcpu_init();
+
+  return featureset_has(&dcpu_cpu.masked, feature);
+}
+
+
+const char *dcpu_hypervisor(void)
+{
+  dcpu_init();
+
+  if (dcpu_cpu.hypervisor_type == HV_NONE)
+    return NULL;
+
+  return get_hypervisor_entry(dcpu_cpu.hypervisor)->name;
+}
+
+
+/* dcpu_os_disabled
+
+returns 1 if the feature is present in the hardware, but its register
+state is not enabled by the OS
+*/
+
+int dcpu_os_disabled(int feature)
+{
+  dcpu_init();
+
+  return featureset_has(&dcpu_cpu.hw_features, feature)
+         && !featureset_has(&dcpu_cpu.features, feature);
+}
+
+
+const char *dcpu_feature_name(int feature)
+{
+  if ((feature < 0) || (feature >= HW_NUM_FEATURES))
+    return NULL;
+
+  return cpu_feature_spec[feature].name;
+}
@@ -0,0 +1,361 @@
+#define _GNU_SOURCE
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "cpu_internal.h"
+
+
+/* limits.c
+
+written by: Oliver Cordes 2019-07-01
+changed by: Oliver Cordes 2019-07-01
+
+*/
+
+
+/* inside of a container the topology of CPUID is the one of the host,
+   the process may use much less of it:
+
+   - the affinity mask (taskset, docker --cpuset-cpus, numactl)
+   - the cpuset of the cgroup, cpuset.cpus.effective (v2) or
+     cpuset.effective_cpus (v1)
+   - the CFS quota, cpu.max (v2) or cpu.cfs_quota_us and
+     cpu.cfs_period_us (v1), a quota of 2.5 CPUs allows 2.5 CPUs worth
+     of run time per period on any number of CPUs
+
+   the cgroup of the process is taken from /proc/self/cgroup, the
+   mount point of the controller from /proc/self/mountinfo. A quota is
+   also limited by all parent cgroups up to the mount point.
+*/
+
+#define CGROUP_PATH 4096
+#define CGROUP_LINE 8192
+
+
+/* has_option
+
+returns 1 if name is one of the comma separated words of list
+*/
+
+static int has_option(const char *list, const char *name)
+{
+  size_t len = strlen(name);
+
+  while (*list != '\0')
+  {
+    if ((strncmp(list, name, len) == 0)
+        && ((list[len] == ',') || (list[len] == '\0')))
+      return 1;
+    list = strchr(list, ',');
+    if (list == NULL)
+      break;
+    ++list;
+  }
+
+  return 0;
+}
+
+
+/* cgroup_path
+
+finds the cgroup of the process for a v1 controller, or for the v2
+hierarchy if controller is NULL, returns 0 on success
+*/
+
+static int cgroup_path(const char *controller, char *path, size_t size)
+{
+  FILE *f;
+  char  line[CGROUP_LINE];
+  char *controllers, *p;
+  int   found = 0;
+
+  f = fopen("/proc/self/cgroup", "r");
+  if (f == NULL)
+    return -1;
+
+  while (!found && (fgets(line, sizeof(line), f) != NULL))
+  {
+    line[strcspn(line, "\n")] = '\0';
+
+    /* hierarchy-ID:controller-list:path */
+    controllers = strchr(line, ':');
+    if (controllers == NULL)
+      continue;
+    ++controllers;
+    p = strchr(controllers, ':');
+    if (p == NULL)
+      continue;
+    *p++ = '\0';
+
+    if (controller == NULL)
+      found = (strncmp(line, "0:", 2) == 0) && (controllers[0] == '\0');
+    else
+      found = has_option(controllers, controller);
+    if (found)
+      snprintf(path, size, "%s", p);
+  }
+  fclose(f);
+
+  return found ? 0 : -1;
+}
+
+
+/* cgroup_mount
+
+finds the mount point and the mounted root of a v1 controller, or of
+the v2 hierarchy if controller is NULL, returns 0 on success
+*/
+
+static int cgroup_mount(const char *controller, char *mount, char *root,
+                        size_t size)
+{
+  FILE *f;
+  char  line[CGROUP_LINE];
+  char *field[5], *fstype, *options, *p;
+  int   found = 0, i;
+
+  f = fopen("/proc/self/mountinfo", "r");
+  if (f == NULL)
+    return -1;
+
+  while (!found && (fgets(line, sizeof(line), f) != NULL))
+  {
+    line[strcspn(line, "\n")] = '\0';
+
+    /* id parent major:minor root mount-point ... - fstype source options */
+    p = line;
+    for (i = 0; i < 5; ++i)
+    {
+      field[i] = strsep(&p, " ");
+      if (field[i] == NULL)
+        break;
+    }
+    if ((i < 5) || (p == NULL))
+      continue;
+    p = strstr(p, " - ");
+    if (p == NULL)
+      continue;
+    p += 3;
+    fstype = strsep(&p, " ");
+    strsep(&p, " ");
+    options = (p != NULL) ? p : "";
+
+    if (controller == NULL)
+      found = (strcmp(fstype, "cgroup2") == 0);
+    else
+      found = (strcmp(fstype, "cgroup") == 0) && has_option(options, controller);
+    if (found)
+    {
+      snprintf(root, size, "%s", field[3]);
+      snprintf(mount, size, "%s", field[4]);
+    }
+  }
+  fclose(f);
+
+  return found ? 0 : -1;
+}
+
+
+/* cgroup_dir
+
+returns the cgroup version of a controller, its directory and the
+mount point, for v1 the controller is looked up first, cgroup_none
+if there is no cgroup
+*/
+
+static int cgroup_dir(const char *controller, char *dir, char *mount,
+                      size_t size)
+{
+  char   path[CGROUP_PATH], root[CGROUP_PATH];
+  size_t len;
+  int    version;
+
+  if ((cgroup_path(controller, path, sizeof(path)) == 0)
+      && (cgroup_mount(controller, mount, root, size) == 0))
+    version = cgroup_v1;
+  else if ((cgroup_path(NULL, path, sizeof(path)) == 0)
+           && (cgroup_mount(NULL, mount, root, size) == 0))
+    version = cgroup_v2;
+  else
+    return cgroup_none;
+
+  /* without a cgroup namespace the mount root is a part of the path */
+  len = strlen(root);
+  if ((len > 1) && (strncmp(path, root, len) == 0)
+      && ((path[len] == '/') || (path[len] == '\0')))
+    memmove(path, path + len, strlen(path + len) + 1);
+  else if ((len > 1) || (strstr(path, "/..") != NULL))
+    path[0] = '\0';      /* not below the mount, use the mount */
+
+  snprintf(dir, size, "%s%s", mount, (strcmp(path, "/") == 0) ? "" : path);
+  len = strlen(dir);
+  while ((len > 1) && (dir[len - 1] == '/'))
+    dir[--len] = '\0';
+
+  return version;
+}
+
+
+static int read_line(const char *dir, const char *name, char *line,
+                     size_t size)
+{
+  FILE *f;
+  char  filename[CGROUP_PATH + 64];
+  int   ok;
+
+  snprintf(filename, sizeof(filename), "%s/%s", dir, name);
+  f = fopen(filename, "r");
+  if (f == NULL)
+    return -1;
+  ok = (fgets(line, size, f) != NULL);
+  fclose(f);
+  if (!ok)
+    return -1;
+  line[strcspn(line, "\n")] = '\0';
+
+  return 0;
+}
+
+
+/* parent_dir
+
+strips the last component of dir, returns 0 if dir is already the
+mount point
+*/
+
+static int parent_dir(char *dir, const char *mount)
+{
+  char *p;
+
+  if (strlen(dir) <= strlen(mount))
+    return 0;
+  p = strrchr(dir, '/');
+  if (p == NULL)
+    return 0;
+  *p = '\0';
+
+  return 1;
+}
+
+
+/* cgroup_quota
+
+returns the smallest CFS quota of the cgroup and its parents in CPUs,
+0.0 if there is none
+*/
+
+static double cgroup_quota(int *version)
+{
+  char   dir[CGROUP_PATH], mount[CGROUP_PATH];
+  char   line[256];
+  long   quota, period;
+  double cpus, best = 0.0;
+
+  *version = cgroup_dir("cpu", dir, mount, CGROUP_PATH);
+  if (*version == cgroup_none)
+    return 0.0;
+
+  do
+  {
+    quota = period = -1;
+    if (*version == cgroup_v2)
+    {
+      /* "max 100000" or "250000 100000" */
+      if ((read_line(dir, "cpu.max", line, sizeof(line)) == 0)
+          && (strncmp(line, "max", 3) != 0))
+        sscanf(line, "%ld %ld", &quota, &period);
+    }
+    else if (read_line(dir, "cpu.cfs_quota_us", line, sizeof(line)) == 0)
+    {
+      quota = strtol(line, NULL, 10);
+      if (read_line(dir, "cpu.cfs_period_us", line, sizeof(line)) == 0)
+        period = strtol(line, NULL, 10);
+    }
+    if ((quota > 0) && (period > 0))
+    {
+      cpus = (double)quota / (double)period;
+      if ((best == 0.0) || (cpus < best))
+        best = cpus;
+    }
+  } while (parent_dir(dir, mount));
+
+  return best;
+}
+
+
+/* cgroup_cpuset
+
+returns the number of CPUs of the cpuset of the cgroup, 0 if there is
+none, the effective list already includes the limits of the parents
+*/
+
+static int cgroup_cpuset(void)
+{
+  char dir[CGROUP_PATH], mount[CGROUP_PATH];
+  char line[CGROUP_LINE];
+
+  switch(cgroup_dir("cpuset", dir, mount, CGROUP_PATH))
+  {
+    case cgroup_v1:
+      if ((read_line(dir, "cpuset.effective_cpus", line, sizeof(line)) == 0)
+          || (read_line(dir, "cpuset.cpus", line, sizeof(line)) == 0))
+        return parse_cpu_list(line, NULL, 0);
+      break;
+    case cgroup_v2:
+      if (read_line(dir, "cpuset.cpus.effective", line, sizeof(line)) == 0)
+        return parse_cpu_list(line, NULL, 0);
+      break;
+  }
+
+  return 0;
+}
+
+
+/* dcpu_limits
+
+combines the probed topology of the affinity mask (dcpu_topology())
+with the cgroup limits and recommends the number of workers, returns
+0 on success and -1 if no CPU of the topology is valid
+*/
+
+int dcpu_limits(const _cpu_topology *cpus, int n, _cpu_limits *lim)
+{
+  _cpu_topology_summary sum;
+  cpu_set_t             set;
+  int                   limit, quota;
+
+  memset(lim, 0, sizeof(_cpu_limits));
+
+  lim->online = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  if (sched_getaffinity(0, sizeof(set), &set) == 0)
+    lim->affinity = CPU_COUNT(&set);
+  lim->cpuset = cgroup_cpuset();
+  lim->quota = cgroup_quota(&lim->cgroup);
+
+  dcpu_topology_summary(cpus, n, &sum, NULL);
+  lim->cores = sum.cores;
+  lim->threads = sum.threads;
+  if (lim->threads == 0)
+    return -1;
+
+  /* the quota is run time, a fraction still needs a whole worker */
+  limit = lim->threads;
+  if ((lim->cpuset > 0) && (lim->cpuset < limit))
+    limit = lim->cpuset;
+  if (lim->quota > 0.0)
+  {
+    quota = (int)lim->quota;
+    if (quota < lim->quota)
+      ++quota;
+    if (quota < limit)
+      limit = quota;
+  }
+
+  lim->thread_workers = limit;
+  lim->core_workers = (lim->cores < limit) ? lim->cores : limit;
+
+  return 0;
+}
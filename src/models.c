@@ -0,0 +1,220 @@
+#include "cpu_internal.h"
+
+
+/* models.c
+
+written by: Oliver Cordes 2019-07-01
+changed by: Oliver Cordes 2019-07-01
+
+*/
+
+
+/* the second classifier: the family, model and stepping of leaf 1
+   name the core exactly, even if a hypervisor masks feature bits.
+   The feature cascade decides -march (only features which are there
+   can be used), the model decides -mtune.
+
+   sources: the model lists of the Linux kernel (intel-family.h) and
+   the AMD revision guides
+*/
+
+
+typedef struct {
+  int          cpu_type;
+  unsigned int family;
+  unsigned int model_first;
+  unsigned int model_last;
+  unsigned int stepping_first;
+  unsigned int stepping_last;
+  int          arch;
+} _cpu_model;
+
+
+#define any_stepping 0x0, 0xf
+
+
+_cpu_model cpu_models[] = {
+  /* Intel family 6, big cores */
+  {CPU_Intel, 0x06, 0x0f, 0x0f, any_stepping, intel_core2},
+  {CPU_Intel, 0x06, 0x16, 0x17, any_stepping, intel_core2},
+  {CPU_Intel, 0x06, 0x1d, 0x1d, any_stepping, intel_core2},
+  {CPU_Intel, 0x06, 0x1a, 0x1a, any_stepping, intel_nehalem},
+  {CPU_Intel, 0x06, 0x1e, 0x1f, any_stepping, intel_nehalem},
+  {CPU_Intel, 0x06, 0x2e, 0x2e, any_stepping, intel_nehalem},
+  {CPU_Intel, 0x06, 0x25, 0x25, any_stepping, intel_westmere},
+  {CPU_Intel, 0x06, 0x2c, 0x2c, any_stepping, intel_westmere},
+  {CPU_Intel, 0x06, 0x2f, 0x2f, any_stepping, intel_westmere},
+  {CPU_Intel, 0x06, 0x2a, 0x2a, any_stepping, intel_sandybridge},
+  {CPU_Intel, 0x06, 0x2d, 0x2d, any_stepping, intel_sandybridge},
+  {CPU_Intel, 0x06, 0x3a, 0x3a, any_stepping, intel_ivybridge},
+  {CPU_Intel, 0x06, 0x3e, 0x3e, any_stepping, intel_ivybridge},
+  {CPU_Intel, 0x06, 0x3c, 0x3c, any_stepping, intel_haswell},
+  {CPU_Intel, 0x06, 0x3f, 0x3f, any_stepping, intel_haswell},
+  {CPU_Intel, 0x06, 0x45, 0x46, any_stepping, intel_haswell},
+  {CPU_Intel, 0x06, 0x3d, 0x3d, any_stepping, intel_broadwell},
+  {CPU_Intel, 0x06, 0x47, 0x47, any_stepping, intel_broadwell},
+  {CPU_Intel, 0x06, 0x4f, 0x4f, any_stepping, intel_broadwell},
+  {CPU_Intel, 0x06, 0x56, 0x56, any_stepping, intel_broadwell},
+  /* Skylake, Kaby Lake, Coffee Lake, Comet Lake */
+  {CPU_Intel, 0x06, 0x4e, 0x4e, any_stepping, intel_skylake},
+  {CPU_Intel, 0x06, 0x5e, 0x5e, any_stepping, intel_skylake},
+  {CPU_Intel, 0x06, 0x8e, 0x8e, any_stepping, intel_skylake},
+  {CPU_Intel, 0x06, 0x9e, 0x9e, any_stepping, intel_skylake},
+  {CPU_Intel, 0x06, 0xa5, 0xa6, any_stepping, intel_skylake},
+  /* Skylake-SP, Cascade Lake and Cooper Lake share the model */
+  {CPU_Intel, 0x06, 0x55, 0x55, 0x0, 0x4, intel_skylake_avx512},
+  {CPU_Intel, 0x06, 0x55, 0x55, 0x5, 0x7, intel_cascadelake},
+  {CPU_Intel, 0x06, 0x55, 0x55, 0xa, 0xb, intel_cooperlake},
+  {CPU_Intel, 0x06, 0x66, 0x66, any_stepping, intel_cannonlake},
+  {CPU_Intel, 0x06, 0x7d, 0x7e, any_stepping, intel_icelake_client},
+  {CPU_Intel, 0x06, 0x6a, 0x6a, any_stepping, intel_icelake_server},
+  {CPU_Intel, 0x06, 0x6c, 0x6c, any_stepping, intel_icelake_server},
+  {CPU_Intel, 0x06, 0x8c, 0x8d, any_stepping, intel_tigerlake},
+  /* Alder Lake, Raptor Lake and Meteor Lake */
+  {CPU_Intel, 0x06, 0x97, 0x97, any_stepping, intel_alderlake},
+  {CPU_Intel, 0x06, 0x9a, 0x9a, any_stepping, intel_alderlake},
+  {CPU_Intel, 0x06, 0xaa, 0xaa, any_stepping, intel_alderlake},
+  {CPU_Intel, 0x06, 0xac, 0xac, any_stepping, intel_alderlake},
+  {CPU_Intel, 0x06, 0xb7, 0xb7, any_stepping, intel_alderlake},
+  {CPU_Intel, 0x06, 0xba, 0xba, any_stepping, intel_alderlake},
+  {CPU_Intel, 0x06, 0xbf, 0xbf, any_stepping, intel_alderlake},
+  {CPU_Intel, 0x06, 0x8f, 0x8f, any_stepping, intel_sapphirerapids},
+  {CPU_Intel, 0x06, 0xcf, 0xcf, any_stepping, intel_emeraldrapids},
+  {CPU_Intel, 0x06, 0xad, 0xad, any_stepping, intel_graniterapids},
+  {CPU_Intel, 0x06, 0xae, 0xae, any_stepping, intel_graniterapids_d},
+  /* Intel family 6, Atom and Xeon Phi */
+  {CPU_Intel, 0x06, 0x1c, 0x1c, any_stepping, intel_bonnell},
+  {CPU_Intel, 0x06, 0x26, 0x26, any_stepping, intel_bonnell},
+  {CPU_Intel, 0x06, 0x37, 0x37, any_stepping, intel_silvermont},
+  {CPU_Intel, 0x06, 0x4a, 0x4a, any_stepping, intel_silvermont},
+  {CPU_Intel, 0x06, 0x4d, 0x4d, any_stepping, intel_silvermont},
+  {CPU_Intel, 0x06, 0x5a, 0x5a, any_stepping, intel_silvermont},
+  {CPU_Intel, 0x06, 0x5d, 0x5d, any_stepping, intel_silvermont},
+  {CPU_Intel, 0x06, 0x5c, 0x5c, any_stepping, intel_goldmont},
+  {CPU_Intel, 0x06, 0x5f, 0x5f, any_stepping, intel_goldmont},
+  {CPU_Intel, 0x06, 0x7a, 0x7a, any_stepping, intel_goldmont_plus},
+  {CPU_Intel, 0x06, 0x86, 0x86, any_stepping, intel_tremont},
+  {CPU_Intel, 0x06, 0x96, 0x96, any_stepping, intel_tremont},
+  {CPU_Intel, 0x06, 0x9c, 0x9c, any_stepping, intel_tremont},
+  {CPU_Intel, 0x06, 0xaf, 0xaf, any_stepping, intel_sierraforest},
+  {CPU_Intel, 0x06, 0x57, 0x57, any_stepping, intel_knl},
+  {CPU_Intel, 0x06, 0x85, 0x85, any_stepping, intel_knm},
+  /* AMD, the family names the core, only the families 15h, 17h
+     and 19h need the model */
+  {CPU_AMD, 0x0f, 0x00, 0xff, any_stepping, amd_athlon64},
+  {CPU_AMD, 0x10, 0x00, 0xff, any_stepping, amd_amdfam10},
+  {CPU_AMD, 0x12, 0x00, 0xff, any_stepping, amd_amdfam10},
+  {CPU_AMD, 0x14, 0x00, 0xff, any_stepping, amd_btver1},
+  {CPU_AMD, 0x15, 0x00, 0x01, any_stepping, amd_bdver1},
+  {CPU_AMD, 0x15, 0x02, 0x2f, any_stepping, amd_bdver2},
+  {CPU_AMD, 0x15, 0x30, 0x3f, any_stepping, amd_bdver3},
+  {CPU_AMD, 0x15, 0x60, 0x7f, any_stepping, amd_bdver4},
+  {CPU_AMD, 0x16, 0x00, 0xff, any_stepping, amd_btver2},
+  {CPU_AMD, 0x17, 0x00, 0x2f, any_stepping, amd_znver1},
+  {CPU_AMD, 0x17, 0x30, 0xff, any_stepping, amd_znver2},
+  {CPU_AMD, 0x19, 0x00, 0x0f, any_stepping, amd_znver3},
+  {CPU_AMD, 0x19, 0x10, 0x1f, any_stepping, amd_znver4},
+  {CPU_AMD, 0x19, 0x20, 0x5f, any_stepping, amd_znver3},
+  {CPU_AMD, 0x19, 0x60, 0x7f, any_stepping, amd_znver4},
+  {CPU_AMD, 0x19, 0xa0, 0xaf, any_stepping, amd_znver4},
+  {CPU_AMD, 0x1a, 0x00, 0xff, any_stepping, amd_znver5},
+  {CPU_Hygon, 0x18, 0x00, 0xff, any_stepping, amd_znver1},
+  /* Zhaoxin KX-6000 and KX-7000 */
+  {CPU_Centauer, 0x07, 0x3b, 0x3b, any_stepping, zhaoxin_lujiazui},
+  {CPU_Zhaoxin, 0x07, 0x3b, 0x3b, any_stepping, zhaoxin_lujiazui},
+  {CPU_Centauer, 0x07, 0x5b, 0x5b, any_stepping, zhaoxin_yongfeng},
+  {CPU_Zhaoxin, 0x07, 0x5b, 0x5b, any_stepping, zhaoxin_yongfeng},
+  {CPU_UNKNOWN, 0, 0, 0, 0, 0, cpu_x86_64}
+};
+
+
+/* decode_signature
+
+splits the signature of leaf 1 EAX into the display family, model
+and stepping, the extended model counts for the families 6 and 15+
+*/
+
+void decode_signature(unsigned int signature, unsigned int *family,
+                      unsigned int *model, unsigned int *stepping)
+{
+  unsigned int f = (signature >> 8) & 0xf;
+  unsigned int m = (signature >> 4) & 0xf;
+
+  if (f == 0xf)
+    f += (signature >> 20) & 0xff;
+  if ((f == 0x6) || (f >= 0xf))
+    m |= ((signature >> 16) & 0xf) << 4;
+
+  *family = f;
+  *model = m;
+  *stepping = signature & 0xf;
+}
+
+
+/* get_model_arch
+
+returns the arch of a vendor and signature, -1 if the model is not
+in the table
+*/
+
+int get_model_arch(int cpu_type, unsigned int signature)
+{
+  unsigned int family, model, stepping;
+  _cpu_model  *m;
+
+  decode_signature(signature, &family, &model, &stepping);
+
+  for (m = cpu_models; m->cpu_type != CPU_UNKNOWN; ++m)
+    if ((m->cpu_type == cpu_type) && (m->family == family)
+        && (model >= m->model_first) && (model <= m->model_last)
+        && (stepping >= m->stepping_first) && (stepping <= m->stepping_last))
+      return m->arch;
+
+  return -1;
+}
+
+
+/* refine_arch
+
+cross-checks the arch of the feature cascade with the arch of the
+model: the model arch wins if it is usable with the features and
+at least enables everything of the feature arch, this tells the
+features-identical archs (e.g. emeraldrapids) apart. Otherwise the
+features decide, e.g. if a hypervisor masks AVX-512.
+*/
+
+int refine_arch(int arch, int model_arch, const _cpu_featureset *features)
+{
+  _cpu_featureset model_req, arch_req;
+
+  if ((model_arch < 0) || (model_arch == arch))
+    return arch;
+
+  get_arch_features(model_arch, &model_req);
+  get_arch_features(arch, &arch_req);
+
+  if (featureset_contains(features, &model_req)
+      && featureset_contains(&model_req, &arch_req))
+    return model_arch;
+
+  return arch;
+}
+
+
+/* dcpu_model_arch
+
+returns the arch of a vendor and signature, -1 if the model is
+unknown
+*/
+
+int dcpu_model_arch(int cpu_type, unsigned int signature)
+{
+  return get_model_arch(cpu_type, signature);
+}
+
+
+void dcpu_signature(unsigned int signature, unsigned int *family,
+                    unsigned int *model, unsigned int *stepping)
+{
+  decode_signature(signature, family, model, stepping);
+}
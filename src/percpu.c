@@ -0,0 +1,169 @@
+#define _GNU_SOURCE
+#include <sched.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "cpu_internal.h"
+
+
+/* percpu.c
+
+written by: Oliver Cordes 2019-07-01
+changed by: Oliver Cordes 2019-07-01
+
+*/
+
+
+/* runs a probe function pinned on every logical CPU of the process
+   affinity mask, all probes run in parallel, one thread per CPU
+*/
+
+
+typedef struct {
+  int        index;
+  int        cpu;
+  _cpu_probe probe;
+  void      *arg;
+  int        ok;
+} _probe_thread;
+
+
+/* get_cpu_list
+
+fills the OS numbers of the CPUs in the affinity mask, returns
+the number of CPUs or -1
+*/
+
+int get_cpu_list(int *cpus, int max)
+{
+  cpu_set_t set;
+  int       cpu;
+  int       n = 0;
+
+  if (sched_getaffinity(0, sizeof(set), &set) != 0)
+    return -1;
+
+  for (cpu = 0; (cpu < CPU_SETSIZE) && (n < max); ++cpu)
+    if (CPU_ISSET(cpu, &set))
+      cpus[n++] = cpu;
+
+  return n;
+}
+
+
+/* parse_cpu_list
+
+parses a CPU list like "0-3,8,10-11", fills up to max CPUs into cpus
+if it is not NULL, returns the number of CPUs of the list
+*/
+
+int parse_cpu_list(const char *list, int *cpus, int max)
+{
+  char *end;
+  long  first, last, cpu;
+  int   n = 0;
+
+  while (*list != '\0')
+  {
+    first = strtol(list, &end, 10);
+    if (end == list)
+      break;
+    last = first;
+    if (*end == '-')
+    {
+      list = end + 1;
+      last = strtol(list, &end, 10);
+      if (end == list)
+        break;
+    }
+    for (cpu = first; cpu <= last; ++cpu, ++n)
+      if ((cpus != NULL) && (n < max))
+        cpus[n] = (int)cpu;
+    list = end;
+    if (*list == ',')
+      ++list;
+  }
+
+  return n;
+}
+
+
+void *probe_thread(void *p)
+{
+  _probe_thread *t = (_probe_thread *)p;
+  cpu_set_t      set;
+
+  CPU_ZERO(&set);
+  CPU_SET(t->cpu, &set);
+
+  if ((sched_setaffinity(0, sizeof(set), &set) == 0)
+      && (sched_getcpu() == t->cpu))
+  {
+    t->probe(t->index, t->cpu, t->arg);
+    t->ok = 1;
+  }
+
+  return NULL;
+}
+
+
+/* run_on_cpus
+
+runs probe(index, cpu, arg) on each of the n CPUs, returns the
+number of CPUs where the probe could be pinned and executed
+*/
+
+int run_on_cpus(const int *cpus, int n, _cpu_probe probe, void *arg)
+{
+  _probe_thread *threads;
+  pthread_t     *ids;
+  char          *started;
+  cpu_set_t      saved;
+  int            restore = 0;
+  int            ok = 0;
+  int            i;
+
+  threads = (_probe_thread *)calloc(n, sizeof(_probe_thread));
+  ids = (pthread_t *)calloc(n, sizeof(pthread_t));
+  started = (char *)calloc(n, sizeof(char));
+  if ((threads == NULL) || (ids == NULL) || (started == NULL))
+  {
+    free(threads);
+    free(ids);
+    free(started);
+    return -1;
+  }
+
+  for (i = 0; i < n; ++i)
+  {
+    threads[i].index = i;
+    threads[i].cpu = cpus[i];
+    threads[i].probe = probe;
+    threads[i].arg = arg;
+    started[i] = pthread_create(&ids[i], NULL, probe_thread, &threads[i]) == 0;
+  }
+
+  for (i = 0; i < n; ++i)
+    if (started[i])
+      pthread_join(ids[i], NULL);
+
+  /* probes without a thread run in the calling thread */
+  for (i = 0; i < n; ++i)
+    if (!started[i])
+    {
+      if (!restore)
+        restore = sched_getaffinity(0, sizeof(saved), &saved) == 0;
+      probe_thread(&threads[i]);
+    }
+  if (restore)
+    sched_setaffinity(0, sizeof(saved), &saved);
+
+  for (i = 0; i < n; ++i)
+    ok += threads[i].ok;
+
+  free(threads);
+  free(ids);
+  free(started);
+
+  return ok;
+}
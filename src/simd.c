@@ -0,0 +1,291 @@
+#include <time.h>
+#include <immintrin.h>
+
+#include "cpu_internal.h"
+
+
+/* simd.c
+
+written by: Oliver Cordes 2019-07-01
+changed by: Oliver Cordes 2019-07-01
+
+*/
+
+
+/* the feature flags don't tell whether wider vectors are faster:
+   one FMA-512 port on some Skylake-SP parts, the AVX-512 frequency
+   licences and Zen1 splitting 256 bit ops into two halves make the
+   wider code slower or not faster. The probe runs the same kernels
+   at 128, 256 and 512 bit and measures the throughput.
+
+   Every kernel runs SIMD_CHAINS independent dependency chains, enough
+   to hide the latency on two ports, compiled for its ISA with a gcc
+   target attribute, so the library itself needs no -m flags.
+*/
+
+#define SIMD_CHAINS    12
+#define SIMD_MIN_NS    20000000.0      /* 20 ms per measurement */
+#define SIMD_RUNS      3
+
+/* a wider vector has to be this much faster to be preferred */
+#define SIMD_MIN_GAIN  1.1
+
+
+typedef double (*_simd_kernel)(long n);
+
+/* the kernels are pure functions, without the barrier gcc would
+   merge the calls with the same n and time nothing */
+#define SIMD_BARRIER() __asm__ __volatile__("" ::: "memory")
+
+static volatile double simd_sink;
+
+
+/* the FMA kernels, single precision */
+
+__attribute__((target("fma")))
+static double fma_128(long n)
+{
+  __m128 acc[SIMD_CHAINS];
+  __m128 m = _mm_set1_ps(0.999999f);
+  __m128 a = _mm_set1_ps(1e-6f);
+  float  r[4];
+  long   k;
+  int    i;
+
+  SIMD_BARRIER();
+
+  for (i = 0; i < SIMD_CHAINS; ++i)
+    acc[i] = _mm_set1_ps((float)i);
+  for (k = 0; k < n; ++k)
+    for (i = 0; i < SIMD_CHAINS; ++i)
+      acc[i] = _mm_fmadd_ps(acc[i], m, a);
+  for (i = 1; i < SIMD_CHAINS; ++i)
+    acc[0] = _mm_add_ps(acc[0], acc[i]);
+  _mm_storeu_ps(r, acc[0]);
+
+  return r[0];
+}
+
+
+__attribute__((target("fma")))
+static double fma_256(long n)
+{
+  __m256 acc[SIMD_CHAINS];
+  __m256 m = _mm256_set1_ps(0.999999f);
+  __m256 a = _mm256_set1_ps(1e-6f);
+  float  r[8];
+  long   k;
+  int    i;
+
+  SIMD_BARRIER();
+
+  for (i = 0; i < SIMD_CHAINS; ++i)
+    acc[i] = _mm256_set1_ps((float)i);
+  for (k = 0; k < n; ++k)
+    for (i = 0; i < SIMD_CHAINS; ++i)
+      acc[i] = _mm256_fmadd_ps(acc[i], m, a);
+  for (i = 1; i < SIMD_CHAINS; ++i)
+    acc[0] = _mm256_add_ps(acc[0], acc[i]);
+  _mm256_storeu_ps(r, acc[0]);
+
+  return r[0];
+}
+
+
+__attribute__((target("avx512f")))
+static double fma_512(long n)
+{
+  __m512 acc[SIMD_CHAINS];
+  __m512 m = _mm512_set1_ps(0.999999f);
+  __m512 a = _mm512_set1_ps(1e-6f);
+  float  r[16];
+  long   k;
+  int    i;
+
+  SIMD_BARRIER();
+
+  for (i = 0; i < SIMD_CHAINS; ++i)
+    acc[i] = _mm512_set1_ps((float)i);
+  for (k = 0; k < n; ++k)
+    for (i = 0; i < SIMD_CHAINS; ++i)
+      acc[i] = _mm512_fmadd_ps(acc[i], m, a);
+  for (i = 1; i < SIMD_CHAINS; ++i)
+    acc[0] = _mm512_add_ps(acc[0], acc[i]);
+  _mm512_storeu_ps(r, acc[0]);
+
+  return r[0];
+}
+
+
+/* the integer kernels, 16 bit multiply-add into 32 bit (pmaddwd) */
+
+static double int_128(long n)
+{
+  __m128i acc[SIMD_CHAINS];
+  __m128i m = _mm_set1_epi16(3);
+  int     r[4];
+  long    k;
+  int     i;
+
+  SIMD_BARRIER();
+
+  for (i = 0; i < SIMD_CHAINS; ++i)
+    acc[i] = _mm_set1_epi32(i);
+  for (k = 0; k < n; ++k)
+    for (i = 0; i < SIMD_CHAINS; ++i)
+      acc[i] = _mm_madd_epi16(acc[i], m);
+  for (i = 1; i < SIMD_CHAINS; ++i)
+    acc[0] = _mm_add_epi32(acc[0], acc[i]);
+  _mm_storeu_si128((__m128i *)r, acc[0]);
+
+  return r[0];
+}
+
+
+__attribute__((target("avx2")))
+static double int_256(long n)
+{
+  __m256i acc[SIMD_CHAINS];
+  __m256i m = _mm256_set1_epi16(3);
+  int     r[8];
+  long    k;
+  int     i;
+
+  SIMD_BARRIER();
+
+  for (i = 0; i < SIMD_CHAINS; ++i)
+    acc[i] = _mm256_set1_epi32(i);
+  for (k = 0; k < n; ++k)
+    for (i = 0; i < SIMD_CHAINS; ++i)
+      acc[i] = _mm256_madd_epi16(acc[i], m);
+  for (i = 1; i < SIMD_CHAINS; ++i)
+    acc[0] = _mm256_add_epi32(acc[0], acc[i]);
+  _mm256_storeu_si256((__m256i *)r, acc[0]);
+
+  return r[0];
+}
+
+
+__attribute__((target("avx512f,avx512bw")))
+static double int_512(long n)
+{
+  __m512i acc[SIMD_CHAINS];
+  __m512i m = _mm512_set1_epi16(3);
+  int     r[16];
+  long    k;
+  int     i;
+
+  SIMD_BARRIER();
+
+  for (i = 0; i < SIMD_CHAINS; ++i)
+    acc[i] = _mm512_set1_epi32(i);
+  for (k = 0; k < n; ++k)
+    for (i = 0; i < SIMD_CHAINS; ++i)
+      acc[i] = _mm512_madd_epi16(acc[i], m);
+  for (i = 1; i < SIMD_CHAINS; ++i)
+    acc[0] = _mm512_add_epi32(acc[0], acc[i]);
+  _mm512_storeu_si512((void *)r, acc[0]);
+
+  return r[0];
+}
+
+
+static double now_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+
+/* measure
+
+calibrates the number of iterations to SIMD_MIN_NS, the calibration
+also warms up the unit (and lets the frequency licence settle), and
+returns the best of SIMD_RUNS runs in operations per ns = G op/s
+*/
+
+static double measure(_simd_kernel kernel, double ops_per_iteration)
+{
+  double t, best = 0.0;
+  long   n = 1024;
+  int    i;
+
+  for (;;)
+  {
+    t = now_ns();
+    simd_sink = kernel(n);
+    t = now_ns() - t;
+    if (t >= SIMD_MIN_NS)
+      break;
+    n *= 2;
+  }
+
+  for (i = 0; i < SIMD_RUNS; ++i)
+  {
+    t = now_ns();
+    simd_sink = kernel(n);
+    t = now_ns() - t;
+    if ((t > 0.0) && (n * ops_per_iteration / t > best))
+      best = n * ops_per_iteration / t;
+  }
+
+  return best;
+}
+
+
+/* dcpu_simd_probe
+
+measures the FMA (GFLOP/s) and the integer (Gop/s) throughput of one
+thread at 128, 256 and 512 bit, widths the CPU (or the OS) doesn't
+support are 0, and recommends a -mprefer-vector-width. Takes about
+half a second.
+*/
+
+void dcpu_simd_probe(_cpu_simd *simd)
+{
+  int lanes, w;
+
+  dcpu_init();
+
+  for (w = 0; w < DCPU_SIMD_WIDTHS; ++w)
+  {
+    simd->fma[w] = 0.0;
+    simd->integer[w] = 0.0;
+  }
+
+  /* 2 flops per FMA and 32 bit lane, 1 op per 32 bit lane */
+  lanes = 4;
+  if (dcpu_has(HW_FMA))
+    simd->fma[0] = measure(fma_128, 2.0 * lanes * SIMD_CHAINS);
+  simd->integer[0] = measure(int_128, 1.0 * lanes * SIMD_CHAINS);
+
+  lanes = 8;
+  if (dcpu_has(HW_FMA) && dcpu_has(HW_AVX))
+    simd->fma[1] = measure(fma_256, 2.0 * lanes * SIMD_CHAINS);
+  if (dcpu_has(HW_AVX2))
+    simd->integer[1] = measure(int_256, 1.0 * lanes * SIMD_CHAINS);
+
+  lanes = 16;
+  if (dcpu_has(HW_AVX512F))
+    simd->fma[2] = measure(fma_512, 2.0 * lanes * SIMD_CHAINS);
+  if (dcpu_has(HW_AVX512F) && dcpu_has(HW_AVX512BW))
+    simd->integer[2] = measure(int_512, 1.0 * lanes * SIMD_CHAINS);
+
+  /* the widest width which is clearly faster than the next narrower
+     one, FMA decides, the integer kernels only without FMA */
+  simd->prefer_width = 128;
+  for (w = 1; w < DCPU_SIMD_WIDTHS; ++w)
+  {
+    if (simd->fma[0] > 0.0)
+    {
+      if (simd->fma[w] < SIMD_MIN_GAIN * simd->fma[w - 1])
+        break;
+    }
+    else if (simd->integer[w] < SIMD_MIN_GAIN * simd->integer[w - 1])
+      break;
+    simd->prefer_width = 128 << w;
+  }
+}
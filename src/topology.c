@@ -0,0 +1,478 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <dirent.h>
+
+#include "cpu_internal.h"
+
+
+/* topology.c
+
+written by: Oliver Cordes 2019-07-01
+changed by: Oliver Cordes 2019-07-01
+
+*/
+
+
+/* the topology is decoded from the (x2)APIC ID of every logical CPU,
+   the APIC ID is split into SMT, core, module, die and package fields
+   by the shift widths of
+
+   EAX=1Fh / EAX=0Bh     V2 / x2APIC extended topology (Intel, Zen2+)
+   EAX=8000001Eh         extended APIC ID, compute unit, node (AMD)
+   EAX=80000008h         ApicIdCoreIdSize (AMD)
+   EAX=1                 logical processors per package (legacy)
+
+   the L3 domain is the APIC ID without the bits of the logical CPUs
+   sharing the L3 (leaf 4 / 8000001Dh), on Zen it is the CCX. The NUMA
+   nodes come from /sys/devices/system/node, they need not match the
+   packages (sub-NUMA clustering, NPS4, CPU-less memory nodes).
+*/
+
+#define NODE_PATH "/sys/devices/system/node"
+#define NODE_LINE 8192
+#define NODE_MAX_CPUS 8192
+
+
+/* level types of leaf 0Bh/1Fh */
+#define topo_invalid 0
+#define topo_smt     1
+#define topo_core    2
+#define topo_module  3
+#define topo_tile    4
+#define topo_die     5
+
+
+typedef struct {
+  unsigned int leaf;       /* 0x1f, 0xb or 0 */
+  int          smt_shift;
+  int          core_shift;
+  int          module_shift;
+  int          die_shift;
+  int          pkg_shift;
+  int          l3_shift;
+} _topo_shifts;
+
+
+int log2_ceil(unsigned int n)
+{
+  int shift = 0;
+
+  while ((1U << shift) < n)
+    ++shift;
+
+  return shift;
+}
+
+
+int extended_topology_valid(unsigned int leaf)
+{
+  int info[4];
+
+  if (!cpuid_leaf_valid(leaf))
+    return 0;
+
+  cpuidcx(info, leaf, 0);
+
+  return (info[1] & 0xffff) != 0;
+}
+
+
+void get_topology_shifts(_topo_shifts *s)
+{
+  const _cpu_cache *l3;
+  int               info[4];
+  int               sub, type, shift;
+
+  s->smt_shift = s->core_shift = s->module_shift = s->die_shift = -1;
+  s->pkg_shift = 0;
+
+  if (extended_topology_valid(0x1f))
+    s->leaf = 0x1f;
+  else if (extended_topology_valid(0x0b))
+    s->leaf = 0x0b;
+  else
+    s->leaf = 0;
+
+  if (s->leaf != 0)
+  {
+    for (sub = 0; sub < 8; ++sub)
+    {
+      cpuidcx(info, s->leaf, sub);
+      type = (info[2] >> 8) & 0xff;
+      if (type == topo_invalid)
+        break;
+      shift = info[0] & 0x1f;
+      switch(type)
+      {
+        case topo_smt:
+          s->smt_shift = shift;
+          break;
+        case topo_core:
+          s->core_shift = shift;
+          break;
+        case topo_module:
+        case topo_tile:
+          s->module_shift = shift;
+          break;
+        case topo_die:
+          s->die_shift = shift;
+          break;
+      }
+      /* the last level reaches the package */
+      s->pkg_shift = shift;
+    }
+  }
+  else if ((dcpu_cpu.cpu_type == CPU_AMD) || (dcpu_cpu.cpu_type == CPU_Hygon))
+  {
+    if (featureset_has(&dcpu_cpu.features, HW_TOPOEXT)
+        && cpuid_leaf_valid(0x8000001e))
+    {
+      cpuid(info, 0x8000001e);
+      s->smt_shift = log2_ceil(((info[1] >> 8) & 0xff) + 1);
+    }
+    if (cpuid_leaf_valid(0x80000008))
+    {
+      cpuid(info, 0x80000008);
+      s->pkg_shift = (info[2] >> 12) & 0xf;
+      if (s->pkg_shift == 0)
+        s->pkg_shift = log2_ceil((info[2] & 0xff) + 1);
+    }
+  }
+  else if (featureset_has(&dcpu_cpu.features, HW_HTT))
+  {
+    cpuid(info, 0x00000001);
+    s->pkg_shift = log2_ceil((info[1] >> 16) & 0xff);
+  }
+
+  /* missing levels collapse into the next lower one */
+  if (s->smt_shift < 0)
+    s->smt_shift = 0;
+  if (s->core_shift < 0)
+    s->core_shift = (s->leaf != 0) ? s->smt_shift : s->pkg_shift;
+  if (s->module_shift < 0)
+    s->module_shift = s->core_shift;
+  if (s->die_shift < 0)
+    s->die_shift = s->module_shift;
+
+  /* without the sharing of the L3 it is one per package */
+  l3 = dcpu_cache(3, cache_unified);
+  if ((l3 != NULL) && (l3->shared > 0))
+    s->l3_shift = log2_ceil(l3->shared);
+  else
+    s->l3_shift = s->pkg_shift;
+}
+
+
+/* get_core_type
+
+returns the core type of the CPU the caller runs on, core_type_none
+if the CPU is not hybrid
+*/
+
+int get_core_type(unsigned int *native_model)
+{
+  int info[4];
+
+  *native_model = 0;
+  if (!featureset_has(&dcpu_cpu.hw_features, HW_HYBRID)
+      || !cpuid_leaf_valid(0x0000001a))
+    return core_type_none;
+
+  cpuidcx(info, 0x0000001a, 0);
+  *native_model = (unsigned int)info[0] & 0xffffff;
+
+  return ((unsigned int)info[0] >> 24) & 0xff;
+}
+
+
+/* get_apic_id
+
+returns the (x2)APIC ID of the CPU the caller runs on
+*/
+
+unsigned int get_apic_id(unsigned int leaf)
+{
+  int info[4];
+
+  if (leaf != 0)
+  {
+    cpuidcx(info, leaf, 0);
+    return (unsigned int)info[3];
+  }
+
+  if (((dcpu_cpu.cpu_type == CPU_AMD) || (dcpu_cpu.cpu_type == CPU_Hygon))
+      && featureset_has(&dcpu_cpu.features, HW_TOPOEXT)
+      && cpuid_leaf_valid(0x8000001e))
+  {
+    cpuid(info, 0x8000001e);
+    return (unsigned int)info[0];
+  }
+
+  cpuid(info, 0x00000001);
+  return ((unsigned int)info[1] >> 24) & 0xff;
+}
+
+
+unsigned int apic_field(unsigned int apic_id, int low, int high)
+{
+  if (high <= low)
+    return 0;
+
+  return (apic_id >> low) & ((1U << (high - low)) - 1);
+}
+
+
+typedef struct {
+  _topo_shifts   shifts;
+  _cpu_topology *cpus;
+} _topo_probe;
+
+
+void topology_probe(int index, int cpu, void *arg)
+{
+  _topo_probe   *p = (_topo_probe *)arg;
+  _cpu_topology *t = &p->cpus[index];
+  _topo_shifts  *s = &p->shifts;
+  unsigned int   native_model;
+  int            info[4];
+
+  t->cpu        = cpu;
+  t->apic_id    = get_apic_id(s->leaf);
+  t->smt_id     = apic_field(t->apic_id, 0, s->smt_shift);
+  t->core_id    = apic_field(t->apic_id, s->smt_shift, s->core_shift);
+  t->module_id  = apic_field(t->apic_id, s->core_shift, s->module_shift);
+  t->die_id     = apic_field(t->apic_id, s->module_shift, s->die_shift);
+  t->package_id = t->apic_id >> s->pkg_shift;
+  t->l3_domain  = t->apic_id >> s->l3_shift;    /* numbered later */
+  t->core_type  = get_core_type(&native_model);
+
+  /* without leaf 0Bh/1Fh the node of AMD CPUs is the die */
+  if ((s->leaf == 0)
+      && ((dcpu_cpu.cpu_type == CPU_AMD) || (dcpu_cpu.cpu_type == CPU_Hygon))
+      && featureset_has(&dcpu_cpu.features, HW_TOPOEXT)
+      && cpuid_leaf_valid(0x8000001e))
+  {
+    cpuid(info, 0x8000001e);
+    t->core_id = apic_field(t->apic_id, s->smt_shift, s->pkg_shift);
+    t->die_id = info[2] & 0xff;
+  }
+
+  t->valid = 1;
+}
+
+
+/* number_l3_domains
+
+replaces the shifted APIC IDs of the L3 domains by 0, 1, ... in the
+order of the CPUs
+*/
+
+void number_l3_domains(_cpu_topology *cpus, int n)
+{
+  int *ids;
+  int  domains = 0, i, d;
+
+  ids = (int *)malloc(n * sizeof(int));
+  if (ids == NULL)
+    return;
+
+  for (i = 0; i < n; ++i)
+  {
+    if (!cpus[i].valid)
+    {
+      cpus[i].l3_domain = -1;
+      continue;
+    }
+    for (d = 0; (d < domains) && (ids[d] != cpus[i].l3_domain); ++d)
+      ;
+    if (d == domains)
+      ids[domains++] = cpus[i].l3_domain;
+    cpus[i].l3_domain = d;
+  }
+
+  free(ids);
+}
+
+
+/* read_nodes
+
+sets the NUMA node of the CPUs from the cpulist of every node
+*/
+
+void read_nodes(_cpu_topology *cpus, int n)
+{
+  DIR           *dir;
+  struct dirent *entry;
+  FILE          *f;
+  char           filename[512];
+  char          *line;
+  int           *list;
+  int            node, count, i, j;
+
+  for (i = 0; i < n; ++i)
+    cpus[i].node = -1;
+
+  dir = opendir(NODE_PATH);
+  if (dir == NULL)
+    return;
+  line = (char *)malloc(NODE_LINE);
+  list = (int *)malloc(NODE_MAX_CPUS * sizeof(int));
+
+  while ((line != NULL) && (list != NULL) && ((entry = readdir(dir)) != NULL))
+  {
+    if (sscanf(entry->d_name, "node%d", &node) != 1)
+      continue;
+    snprintf(filename, sizeof(filename), NODE_PATH "/%s/cpulist",
+             entry->d_name);
+    f = fopen(filename, "r");
+    if (f == NULL)
+      continue;
+    if (fgets(line, NODE_LINE, f) != NULL)
+    {
+      count = parse_cpu_list(line, list, NODE_MAX_CPUS);
+      for (j = 0; (j < count) && (j < NODE_MAX_CPUS); ++j)
+        for (i = 0; i < n; ++i)
+          if (cpus[i].cpu == list[j])
+            cpus[i].node = node;
+    }
+    fclose(f);
+  }
+
+  free(line);
+  free(list);
+  closedir(dir);
+}
+
+
+/* dcpu_topology
+
+fills the topology of all CPUs of the affinity mask into cpus, returns
+the number of CPUs or -1 on errors. Every CPU is probed by a thread
+pinned to that CPU. A replayed dump has no CPUs to pin to, -1 then.
+*/
+
+int dcpu_topology(_cpu_topology *cpus, int max)
+{
+  _topo_probe probe;
+  int        *list;
+  int         n, i;
+
+  dcpu_init();
+
+  if (cpuid_replaying())
+    return -1;
+
+  list = (int *)malloc(max * sizeof(int));
+  if (list == NULL)
+    return -1;
+
+  n = get_cpu_list(list, max);
+  if (n > 0)
+  {
+    get_topology_shifts(&probe.shifts);
+    probe.cpus = cpus;
+    for (i = 0; i < n; ++i)
+    {
+      cpus[i].cpu = list[i];
+      cpus[i].valid = 0;
+    }
+    if (run_on_cpus(list, n, topology_probe, &probe) < 0)
+      n = -1;
+    else
+    {
+      number_l3_domains(cpus, n);
+      read_nodes(cpus, n);
+    }
+  }
+
+  free(list);
+
+  return n;
+}
+
+
+int same_package(const _cpu_topology *a, const _cpu_topology *b)
+{
+  return a->package_id == b->package_id;
+}
+
+
+int same_die(const _cpu_topology *a, const _cpu_topology *b)
+{
+  return (a->package_id == b->package_id) && (a->die_id == b->die_id);
+}
+
+
+int same_l3_domain(const _cpu_topology *a, const _cpu_topology *b)
+{
+  return a->l3_domain == b->l3_domain;
+}
+
+
+int same_node(const _cpu_topology *a, const _cpu_topology *b)
+{
+  return a->node == b->node;
+}
+
+
+int same_core(const _cpu_topology *a, const _cpu_topology *b)
+{
+  return (a->package_id == b->package_id) && (a->die_id == b->die_id)
+         && (a->module_id == b->module_id) && (a->core_id == b->core_id);
+}
+
+
+/* seen_before
+
+returns 1 if one of the first n valid CPUs matches cpu
+*/
+
+int seen_before(const _cpu_topology *cpus, int n, const _cpu_topology *cpu,
+                int (*same)(const _cpu_topology *, const _cpu_topology *))
+{
+  int i;
+
+  for (i = 0; i < n; ++i)
+    if (cpus[i].valid && same(&cpus[i], cpu))
+      return 1;
+
+  return 0;
+}
+
+
+/* dcpu_topology_summary
+
+counts the packages, dies, physical cores and threads of the probed
+CPUs, if core_cpus is not NULL it gets the first CPU of every core
+*/
+
+void dcpu_topology_summary(const _cpu_topology *cpus, int n,
+                           _cpu_topology_summary *sum, int *core_cpus)
+{
+  int i;
+
+  sum->packages = sum->dies = sum->cores = sum->threads = 0;
+  sum->l3_domains = sum->nodes = 0;
+
+  for (i = 0; i < n; ++i)
+  {
+    if (!cpus[i].valid)
+      continue;
+
+    ++sum->threads;
+    if (!seen_before(cpus, i, &cpus[i], same_package))
+      ++sum->packages;
+    if (!seen_before(cpus, i, &cpus[i], same_die))
+      ++sum->dies;
+    if (!seen_before(cpus, i, &cpus[i], same_l3_domain))
+      ++sum->l3_domains;
+    if ((cpus[i].node >= 0) && !seen_before(cpus, i, &cpus[i], same_node))
+      ++sum->nodes;
+    if (!seen_before(cpus, i, &cpus[i], same_core))
+    {
+      if (core_cpus != NULL)
+        core_cpus[sum->cores] = cpus[i].cpu;
+      ++sum->cores;
+    }
+  }
+}
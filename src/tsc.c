@@ -0,0 +1,199 @@
+#include <time.h>
+#include <x86intrin.h>
+
+#include "cpu_internal.h"
+
+
+/* tsc.c
+
+written by: Oliver Cordes 2019-07-01
+changed by: Oliver Cordes 2019-07-01
+
+*/
+
+
+/* the TSC frequency comes from, in that order:
+
+   - leaf 15h, the TSC/crystal clock ratio and the crystal clock, if
+     the crystal isn't enumerated (Skylake client) it is derived from
+     the base clock of leaf 16h
+   - leaf 40000010h of KVM and VMware in a guest
+   - a calibration against CLOCK_MONOTONIC_RAW
+
+   only an invariant TSC ticks at that rate all the time
+*/
+
+#define TSC_CALIBRATION_NS  10000000L     /* 10 ms */
+#define TSC_BRACKET_TRIES   5
+
+/* Goldmont doesn't enumerate its crystal clock */
+#define GOLDMONT_CRYSTAL_HZ 19200000UL
+
+
+static long long raw_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+
+  return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+
+/* tsc_sample
+
+reads the TSC between two clock reads, of some tries the one with
+the narrowest clock window is kept, the clock time is the middle of
+that window
+*/
+
+static void tsc_sample(uint64_t *tsc, long long *ns)
+{
+  long long t0, t1, best = -1;
+  uint64_t  c;
+  int       i;
+
+  for (i = 0; i < TSC_BRACKET_TRIES; ++i)
+  {
+    t0 = raw_ns();
+    c = __rdtsc();
+    t1 = raw_ns();
+    if ((best < 0) || (t1 - t0 < best))
+    {
+      best = t1 - t0;
+      *tsc = c;
+      *ns = t0 + (t1 - t0) / 2;
+    }
+  }
+}
+
+
+/* calibrate_tsc
+
+returns the TSC frequency measured over TSC_CALIBRATION_NS
+*/
+
+static uint64_t calibrate_tsc(void)
+{
+  uint64_t  c0, c1;
+  long long t0, t1;
+
+  tsc_sample(&c0, &t0);
+  while (raw_ns() - t0 < TSC_CALIBRATION_NS)
+    ;
+  tsc_sample(&c1, &t1);
+
+  if ((t1 <= t0) || (c1 <= c0))
+    return 0;
+
+  return (uint64_t)((double)(c1 - c0) * 1e9 / (double)(t1 - t0) + 0.5);
+}
+
+
+/* get_tsc
+
+fills tsc with the TSC properties and the frequency, calibrates the
+TSC only if calibrate is set and CPUID doesn't know the frequency
+*/
+
+static void get_tsc(_cpu_tsc *tsc, int calibrate)
+{
+  unsigned int family, model, stepping;
+  int          info[4];
+
+  dcpu_init();
+
+  tsc->invariant = featureset_has(&dcpu_cpu.hw_features, HW_INVTSC);
+  tsc->source = tsc_source_none;
+  tsc->tsc_hz = 0;
+  tsc->ns_per_tick = 0.0;
+  tsc->crystal_hz = 0;
+  tsc->base_mhz = 0;
+  tsc->max_mhz = 0;
+  tsc->bus_mhz = 0;
+
+  if (!featureset_has(&dcpu_cpu.hw_features, HW_TSC))
+    return;
+
+  if (cpuid_leaf_valid(0x00000016))
+  {
+    cpuid(info, 0x00000016);
+    tsc->base_mhz = info[0] & 0xffff;
+    tsc->max_mhz = info[1] & 0xffff;
+    tsc->bus_mhz = info[2] & 0xffff;
+  }
+
+  if (cpuid_leaf_valid(0x00000015))
+  {
+    /* EAX = denominator, EBX = numerator, ECX = crystal clock */
+    cpuid(info, 0x00000015);
+    if ((info[0] != 0) && (info[1] != 0))
+    {
+      tsc->crystal_hz = (unsigned int)info[2];
+      decode_signature(dcpu_cpu.signature, &family, &model, &stepping);
+      if ((tsc->crystal_hz == 0) && (dcpu_cpu.cpu_type == CPU_Intel)
+          && (family == 0x6) && (model == 0x5c))
+        tsc->crystal_hz = GOLDMONT_CRYSTAL_HZ;
+      if ((tsc->crystal_hz == 0) && (tsc->base_mhz != 0))
+        tsc->crystal_hz = (unsigned long)((uint64_t)tsc->base_mhz * 1000000
+                                          * (unsigned int)info[0]
+                                          / (unsigned int)info[1]);
+      if (tsc->crystal_hz != 0)
+      {
+        tsc->tsc_hz = (uint64_t)tsc->crystal_hz * (unsigned int)info[1]
+                      / (unsigned int)info[0];
+        tsc->source = tsc_source_cpuid;
+      }
+    }
+  }
+
+  /* the timing leaf of KVM and VMware, EAX = TSC kHz */
+  if ((tsc->source == tsc_source_none)
+      && ((dcpu_cpu.hypervisor_type == HV_KVM)
+          || (dcpu_cpu.hypervisor_type == HV_VMWARE))
+      && (dcpu_cpu.hypervisor_level >= dcpu_cpu.hypervisor_leaf + 0x10))
+  {
+    cpuid(info, dcpu_cpu.hypervisor_leaf + 0x10);
+    if (info[0] != 0)
+    {
+      tsc->tsc_hz = (uint64_t)(unsigned int)info[0] * 1000;
+      tsc->source = tsc_source_hypervisor;
+    }
+  }
+
+  if (calibrate && (tsc->source == tsc_source_none) && !cpuid_replaying())
+  {
+    tsc->tsc_hz = calibrate_tsc();
+    if (tsc->tsc_hz != 0)
+      tsc->source = tsc_source_calibrated;
+  }
+
+  if (tsc->tsc_hz != 0)
+    tsc->ns_per_tick = 1e9 / (double)tsc->tsc_hz;
+}
+
+
+/* dcpu_tsc
+
+fills tsc with the TSC properties and the frequency, the result
+doesn't change, callers should keep it. Without a frequency in CPUID
+the TSC is calibrated for 10 ms. A replayed dump is never calibrated,
+the local TSC doesn't belong to it.
+*/
+
+void dcpu_tsc(_cpu_tsc *tsc)
+{
+  get_tsc(tsc, 1);
+}
+
+
+/* dcpu_tsc_cpuid
+
+like dcpu_tsc(), but only the frequency of CPUID or the hypervisor,
+never calibrates, the frequency may stay unknown
+*/
+
+void dcpu_tsc_cpuid(_cpu_tsc *tsc)
+{
+  get_tsc(tsc, 0);
+}
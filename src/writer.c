@@ -0,0 +1,188 @@
+#include <unistd.h>
+#include <errno.h>
+
+#include "writer.h"
+
+
+/* writer.c
+
+written by: Oliver Cordes 2019-07-01
+changed by: Oliver Cordes 2019-07-01
+
+*/
+
+
+void writer_init(_writer *w, char *buf, size_t size)
+{
+  w->buf = buf;
+  w->size = size;
+  w->len = 0;
+  w->overflow = 0;
+}
+
+
+void writer_char(_writer *w, char c)
+{
+  if (w->len < w->size)
+    w->buf[w->len++] = c;
+  else
+    w->overflow = 1;
+}
+
+
+void writer_str(_writer *w, const char *s)
+{
+  while (*s != '\0')
+    writer_char(w, *s++);
+}
+
+
+void writer_uint(_writer *w, unsigned long long v)
+{
+  char tmp[24];
+  int  n = 0;
+
+  do
+  {
+    tmp[n++] = (char)('0' + (v % 10));
+    v /= 10;
+  } while (v != 0);
+
+  while (n > 0)
+    writer_char(w, tmp[--n]);
+}
+
+
+void writer_int(_writer *w, long long v)
+{
+  if (v < 0)
+  {
+    writer_char(w, '-');
+    writer_uint(w, (unsigned long long)(-(v + 1)) + 1);
+  }
+  else
+    writer_uint(w, (unsigned long long)v);
+}
+
+
+void writer_hex(_writer *w, unsigned long long v)
+{
+  static const char digits[] = "0123456789abcdef";
+  char tmp[16];
+  int  n = 0;
+
+  do
+  {
+    tmp[n++] = digits[v & 0xf];
+    v >>= 4;
+  } while (v != 0);
+
+  writer_str(w, "0x");
+  while (n > 0)
+    writer_char(w, tmp[--n]);
+}
+
+
+/* writer_json_string
+
+writes a quoted JSON string, control characters are escaped
+*/
+
+void writer_json_string(_writer *w, const char *s)
+{
+  static const char digits[] = "0123456789abcdef";
+
+  writer_char(w, '"');
+  for (; *s != '\0'; ++s)
+  {
+    if ((*s == '"') || (*s == '\\'))
+    {
+      writer_char(w, '\\');
+      writer_char(w, *s);
+    }
+    else if ((unsigned char)*s < 0x20)
+    {
+      writer_str(w, "\\u00");
+      writer_char(w, digits[(*s >> 4) & 0xf]);
+      writer_char(w, digits[*s & 0xf]);
+    }
+    else
+      writer_char(w, *s);
+  }
+  writer_char(w, '"');
+}
+
+
+/* writer_shell_string
+
+writes a single quoted string for sh, a single quote becomes '\''
+*/
+
+void writer_shell_string(_writer *w, const char *s)
+{
+  writer_char(w, '\'');
+  for (; *s != '\0'; ++s)
+  {
+    if (*s == '\'')
+      writer_str(w, "'\\''");
+    else
+      writer_char(w, *s);
+  }
+  writer_char(w, '\'');
+}
+
+
+/* writer_cpuset
+
+writes a sorted CPU list in the taskset/numactl list format,
+e.g. 0-3,8,10-11
+*/
+
+void writer_cpuset(_writer *w, const int *cpus, int n)
+{
+  int i, last;
+
+  for (i = 0; i < n; i = last + 1)
+  {
+    last = i;
+    while ((last + 1 < n) && (cpus[last + 1] == cpus[last] + 1))
+      ++last;
+    if (i > 0)
+      writer_char(w, ',');
+    writer_int(w, cpus[i]);
+    if (last != i)
+    {
+      writer_char(w, '-');
+      writer_int(w, cpus[last]);
+    }
+  }
+}
+
+
+/* writer_flush
+
+writes the buffer with a single write(), only a partial write is
+continued. Returns 0 on success, -1 on errors or if the output was
+truncated.
+*/
+
+int writer_flush(_writer *w, int fd)
+{
+  size_t  done = 0;
+  ssize_t n;
+
+  while (done < w->len)
+  {
+    n = write(fd, w->buf + done, w->len - done);
+    if (n < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      return -1;
+    }
+    done += (size_t)n;
+  }
+  w->len = 0;
+
+  return w->overflow ? -1 : 0;
+}
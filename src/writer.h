@@ -0,0 +1,37 @@
+/* writer.h
+
+written by: Oliver Cordes 2019-07-01
+changed by: Oliver Cordes 2019-07-01
+
+*/
+
+/* append-only writer into a fixed buffer, the whole output is
+   flushed with a single write()
+*/
+
+#ifndef WRITER_H
+#define WRITER_H
+
+#include <stddef.h>
+
+
+typedef struct {
+  char   *buf;
+  size_t  size;
+  size_t  len;
+  int     overflow;     /* 1 if output was dropped */
+} _writer;
+
+
+void writer_init(_writer *w, char *buf, size_t size);
+void writer_str(_writer *w, const char *s);
+void writer_char(_writer *w, char c);
+void writer_uint(_writer *w, unsigned long long v);
+void writer_int(_writer *w, long long v);
+void writer_hex(_writer *w, unsigned long long v);
+void writer_json_string(_writer *w, const char *s);
+void writer_shell_string(_writer *w, const char *s);
+void writer_cpuset(_writer *w, const int *cpus, int n);
+int  writer_flush(_writer *w, int fd);
+
+#endif
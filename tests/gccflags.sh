@@ -0,0 +1,72 @@
+#!/bin/sh
+#
+# gccflags.sh DETECT-CPU GCC FEATURES-H DUMP
+#
+# replays DUMP with -f for the release of GCC and checks the options
+# against gcc -Q --help=target: they have to enable exactly the
+# features of the dump which have a gcc option, and every -m<x> and
+# -mno-<x> has to change what -march=<arch> alone enables
+#
+# written by: Oliver Cordes 2019-07-01
+# changed by: Oliver Cordes 2019-07-01
+
+detect_cpu=$1
+gcc=$2
+features_h=$3
+dump=$4
+
+major=$("$gcc" -dumpversion | cut -d. -f1)
+
+dir=$(mktemp -d) || exit 1
+trap 'rm -rf "$dir"' EXIT
+
+# cpuid name and gcc option of every feature this gcc knows
+sed -n 's/^CPU_FEATURE(.*"\([^"]*\)", *"\([^"]*\)", *\([0-9]*\))$/\1 \2 \3/p' \
+    "$features_h" | awk -v major="$major" '$3 <= major { print $1, $2 }' \
+    | sort > "$dir/names"
+cut -d' ' -f2 "$dir/names" | sort -u > "$dir/options"
+
+# the -m options gcc enables with the options $1...
+gcc_enabled()
+{
+  "$gcc" "$@" -Q --help=target \
+    | awk '$2 == "[enabled]" && $1 ~ /^-m/ { print substr($1, 3) }' \
+    | sort | comm -12 - "$dir/options"
+}
+
+flags=$("$detect_cpu" -r "$dump" -G "$major" -f) || exit 1
+
+eval "$("$detect_cpu" -r "$dump" -e | grep '^DCPU_FLAGS=')"
+for name in $DCPU_FLAGS; do
+  echo "$name"
+done | sort | join - "$dir/names" | cut -d' ' -f2 | sort -u > "$dir/expected"
+
+gcc_enabled $flags > "$dir/got"
+if ! diff -u "$dir/expected" "$dir/got"; then
+  echo "$flags enables other features than $dump has"
+  exit 1
+fi
+
+march=
+for flag in $flags; do
+  case $flag in
+    -march=*) march=$flag ;;
+  esac
+done
+gcc_enabled $march > "$dir/march"
+
+for flag in $flags; do
+  case $flag in
+    -march=*|-mtune=*) ;;
+    -mno-*)
+      if ! grep -qx -- "${flag#-mno-}" "$dir/march"; then
+        echo "$flag is redundant, $march doesn't enable it"
+        exit 1
+      fi ;;
+    -m*)
+      if grep -qx -- "${flag#-m}" "$dir/march"; then
+        echo "$flag is redundant, $march enables it"
+        exit 1
+      fi ;;
+  esac
+done
@@ -0,0 +1,30 @@
+#!/bin/sh
+#
+# launch.sh DETECT-CPU DUMP EXPECTED BUILD...
+#
+# creates stub builds app.BUILD in a temporary directory, replays DUMP
+# with -x and checks that the launcher picks app.EXPECTED
+#
+# written by: Oliver Cordes 2019-07-01
+# changed by: Oliver Cordes 2019-07-01
+
+detect_cpu=$1
+dump=$2
+expected=$3
+shift 3
+
+dir=$(mktemp -d) || exit 1
+trap 'rm -rf "$dir"' EXIT
+
+for build in "$@"; do
+  printf '#!/bin/sh\necho %s "$#"\n' "$build" > "$dir/app.$build"
+  chmod +x "$dir/app.$build"
+done
+
+# 5000 arguments, none may get lost
+result=$("$detect_cpu" -r "$dump" -x "$dir/app" $(seq 5000))
+
+if [ "$result" != "$expected 5000" ]; then
+  echo "expected '$expected 5000', got '$result'"
+  exit 1
+fi